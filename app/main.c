@@ -34,15 +34,32 @@
 // Includes
 //-----------------------------------------------------------------------------+
 
+#include "boot_time.h"
 #include "bsp/board_api.h"
 #include "class/hid/hid.h"
+#ifdef KIBO_CONSOLE
+#include "console.h"
+#endif
 #include "debug_led.h"
 #include "delta_time.h"
-#include "hardware/uart.h"
+#include "gaming.h"
+#include "hid_report.h"
 #include "input_parse.h"
+#include "key_health.h"
 #include "key_map.h"
+#include "key_repeat.h"
+#include "key_scan.h"
+#include "key_state.h"
+#include "link.h"
+#include "loop_watchdog.h"
 #include "pico/stdlib.h"
 #include "pin_helper.h"
+#include "power.h"
+#include "profiler.h"
+#include "role.h"
+#include "scan_governor.h"
+#include "storage.h"
+#include "trace.h"
 #include "tusb.h"
 #include "tusb_config.h"
 #include "types.h"
@@ -57,31 +74,70 @@
 // Constants and declarations
 //-----------------------------------------------------------------------------+
 
-// #define KIBO_LEFT <- Now defined (or not) using build parameters
-
-#define UART_TX_PIN 0
-#define UART_RX_PIN 1
+// The keyboard half is now detected at runtime, see role.h
+// The link's own constants are in link.h, this times the slave's keyframes (see send_uart())
+static struct cooldown_timer keyframe_cdt = {LINK_KEYFRAME_INTERVAL, 0};
 
-const u32 key_send_cooldown = 4;
-const u32 frame_delay = 1;
+#define STORAGE_IDLE_TIME 5000  // ms without activity before a save may stall the loop
 
-bool is_master = true;
+// Tables kept across reboots, changing them discards what was saved by older firmwares
+// Only this half's rows, the other half's keys are never measured here, set in init() once the side is known
+static storage_section saved_sections[2];
 
 void init();
-void send_hid_report(const u8* keycodes);
-void send_uart(const u8 key, const key_events event);
+void update();
+void send_uart();
 void parse_inputs();
+void handle_key_event(u32 key, key_events event);
+void handle_key_events();
 void handle_events();
+void handle_repeat();
 void handle_uart();
 
+#ifdef KIBO_CONSOLE
+void console_link(const char* args);
+void console_scan(const char* args);
+void console_health(const char* args);
+void console_boot(const char* args);
+void console_power(const char* args);
+void console_watchdog(const char* args);
+
+static const console_param app_params[] = {
+    {"repeat_delay",      &repeat_rates[repeat_NORMAL].delay,    0,  2000        },
+    {"repeat_interval",   &repeat_rates[repeat_NORMAL].interval, 0,  1000        },
+    {"fast_delay",        &repeat_rates[repeat_FAST].delay,      0,  2000        },
+    {"fast_interval",     &repeat_rates[repeat_FAST].interval,   0,  1000        },
+    {"scan_active_us",    &governor_periods[governor_ACTIVE],    50, 10000       },
+    {"scan_idle_us",      &governor_periods[governor_IDLE],      50, 100000      },
+    {"scan_suspended_us", &governor_periods[governor_SUSPENDED], 50, 1000000     },
+    {"idle_after",        &governor_idle_after,                  1,  60000       },
+    {"socd_mode",         &socd_mode,                            0,  socd_MAX - 1},
+    {"tap_ttl_ms",        &report_tap_ttl_ms,                    0,  10000       },
+#ifdef KEY_MATRIX
+    {"matrix_settle_us",  &matrix_settle_us,                     1,  1000        },
+#endif
+};
+
+static const console_command app_commands[] = {
+    {"link", "role and half-to-half link counters", console_link},
+    {"scan", "scan rate governor state and frames [reset]", console_scan},
+    {"health", "switch health of this half [reset|save]", console_health},
+    {"boot", "time from reset to each boot stage", console_boot},
+    {"power", "suspend state and remote wakeup latency", console_power},
+    {"watchdog", "last reset cause and where the main loop last hung", console_watchdog},
+};
+#endif
+
 //-----------------------------------------------------------------------------+
 // Main
 //-----------------------------------------------------------------------------+
 
 /*
  *  Notes:
- *  You need to call tud_task() before every call to tud_hid_keyboard_report()
- *  You need to wait at least 4 ms before flushing the keys.
+ *  You need to call tud_task() for reports to go out and their buffers to be freed (see hid_report.h).
+ *  Everything from scanning a key to building its report runs from SRAM (__not_in_flash_func),
+ *  so USB or console activity evicting the flash cache doesn't add jitter to key latency.
+ *  Reports are paced by the host's polling, nothing sleeps in the main loop besides the scan governor.
  */
 
 int main(void)
@@ -90,200 +146,427 @@ int main(void)
 
     while (1)
     {
-        tud_task();
-        delta_time_update();
+        update();
+    }
+}
 
-        parse_inputs();
-        handle_events();
-        if (is_master)
-        {
-            handle_uart();
-        }
+// One iteration of the main loop, a host build steps the firmware with it (see host/)
+void update()
+{
+    profiler_frame();
+
+    profiler_begin(stage_TUD_TASK);
+    tud_task();
+    profiler_end(stage_TUD_TASK);
+
+    profiler_begin(stage_DELTA_TIME);
+    delta_time_update();
+    profiler_end(stage_DELTA_TIME);
 
-        sleep_ms(frame_delay);
+    profiler_begin(stage_PARSE_INPUTS);
+    parse_inputs();
+    profiler_end(stage_PARSE_INPUTS);
+
+    profiler_begin(stage_HANDLE_EVENTS);
+    handle_events();
+    handle_repeat();
+    if (!gaming_update())
+    {
+        report_update();
     }
+    profiler_end(stage_HANDLE_EVENTS);
+
+    // Both halves listen, role negotiation goes both ways
+    profiler_begin(stage_HANDLE_UART);
+    handle_uart();
+    link_tick();
+    role_tick();
+    power_update();
+    profiler_end(stage_HANDLE_UART);
+
+    debug_led_update();
+    storage_update(scan_governor_idle_for(STORAGE_IDLE_TIME));
+
+#ifdef KIBO_CONSOLE
+    profiler_begin(stage_CONSOLE);
+    console_update();
+    profiler_end(stage_CONSOLE);
+#endif
+
+    scan_governor_update(inputs_busy());
+    scan_governor_wait();
+    loop_watchdog_feed();
 }
 
+// Keys are scanned and the link is up before USB, enumeration takes longer than everything else
+// and keys pressed meanwhile are kept until the host is there (see hid_report.h)
 void init()
 {
+    boot_stamp(boot_MAIN);
+    loop_watchdog_init();
     board_init();
+    power_init();
     debug_led_init();
+    link_init();
+    role_init();
 
-    for (u32 i = 0; i < GP_COUNT; ++i)
+    key_map_init();
+    key_scan_init(local_side());
+    delta_time_reset();  // Else the first delta is the time since reset, and a key held at boot skips debounce
+    parse_inputs();
+    boot_stamp(boot_SCAN);
+
+    const u32 first_key = key_position(local_side(), 0);
+    saved_sections[0] = (storage_section){&key_healths[first_key], GP_COUNT * sizeof(key_healths[0])};
+    saved_sections[1] = (storage_section){key_bounce_histograms[first_key], GP_COUNT * sizeof(key_bounce_histograms[0])};
+    storage_init(saved_sections, sizeof(saved_sections) / sizeof(saved_sections[0]));
+    key_health_init();
+
+    // init device stack on configured roothub port
+    // Both halves do it, the one that gets mounted by a host becomes the master
+    tud_init(BOARD_TUD_RHPORT);
+    debug_led_off();
+
+    if (board_init_after_tusb)
     {
-#ifdef KIBO_LEFT
-        gp_on(get_gp_left(i));
-#else
-        gp_on(get_gp_right(i));
+        board_init_after_tusb();
+    }
+
+#ifdef KIBO_CONSOLE
+    console_init(app_params, sizeof(app_params) / sizeof(app_params[0]), app_commands, sizeof(app_commands) / sizeof(app_commands[0]));
 #endif
+
+    delta_time_reset();
+    loop_watchdog_start();
+}
+
+void send_uart()
+{
+    static key_bits sent_state;
+
+    key_bits state;
+    half_state(local_side(), &state);
+    u8 payload[KEY_STATE_BYTES];
+
+    // Keyframes resynchronize the master if it missed something, e.g. when it just booted or the link was lost
+    // A delta is against the last state sent, which the master never got if the link gave up on it
+    // The interval counts from the last keyframe sent, not caught up on after boot, a flash write or suspend
+    peer_needs_keyframe |= link_gave_up();
+    const bool is_keyframe_due = keyframe_cdt.last_update + keyframe_cdt.cooldown <= board_millis();
+    u32 len = 0;
+    if (!is_keyframe_due && !peer_needs_keyframe)
+    {
+        if (key_bits_equal(&state, &sent_state))
+        {
+            return;
+        }
+        len = key_state_encode_delta(&sent_state, &state, payload);
     }
 
-    // init device stack on configured roothub port
-    is_master = gp_get(PICO_VBUS_PIN);
-    if (is_master)
+    bool is_sent = false;
+    if (len == 0)
     {
-        tud_init(BOARD_TUD_RHPORT);
-        // debug_led_on();
-        debug_led_off();
+        key_state_write(&state, payload);
+        is_sent = link_send_reliable(link_STATE_KEYFRAME, payload, KEY_STATE_BYTES);
     }
     else
     {
-        debug_led_off();
+        is_sent = link_send_reliable(link_STATE_DELTA, payload, len);
     }
 
-    if (board_init_after_tusb)
+    // Otherwise the window is full, try again next frame
+    if (is_sent)
     {
-        board_init_after_tusb();
+        sent_state = state;
+        peer_needs_keyframe = false;
+        if (len == 0)
+        {
+            keyframe_cdt.last_update = board_millis();
+        }
     }
+}
 
-    // Set up our UART with the required speed.
-    uart_init(uart0, 115200);
-
-    // Set the TX and RX pins by using the function select on the GPIO
-    // Set datasheet for more information on function select
-    gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
+void __not_in_flash_func(parse_inputs)()
+{
+    key_bits raw;
+    key_scan(local_side(), &raw);
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        update_input(key_position(local_side(), i), key_bits_get(&raw, i));
+    }
 }
 
-void send_hid_report(const u8* keycodes)
+// Single place where key events become actions, only ever called on the master
+void __not_in_flash_func(handle_key_event)(u32 key, key_events event)
 {
+    // Like a host's typematic repeat, pressing another key stops the current one
+    if (event == event_DOWN)
+    {
+        key_repeat_stop();
+        power_key_down();
+    }
+
+    const u8* keycodes = get_keycodes(key, event);
+
+    // If it's a layer change, handle it internally
+    if (keycodes[0] == HID_KEY_GOTO_LAYER)
+    {
+        change_layer(keycodes[1]);
+        return;
+    }
+
+    // Keys of gaming layers are held rather than tapped, releases included, see gaming.h
+    if (is_gaming_layer())
+    {
+        gaming_key_event(key, event, keycodes);
+        return;
+    }
+
     if (keycodes[0] == HID_KEY_NONE)
     {
         return;
     }
 
-    tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, keycodes);
-    sleep_ms(key_send_cooldown);
-    tud_task();
+    // Send actual keycodes to the computer via USB, see hid_report.h
+    report_tap(key, keycodes);
 
-    tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-    sleep_ms(key_send_cooldown);
-    tud_task();
+    if (event == event_DOWN)
+    {
+        key_repeat_start(key, keycodes, get_repeat(key));
+    }
 }
 
-void send_uart(const u8 key, const key_events event)
+// Both halves' keys go through the same queue, in the order debounce decided on them
+void __not_in_flash_func(handle_key_events)()
 {
-    if (uart_is_writable(uart0))
+    key_event e;
+    while (event_queue_pop(&e))
     {
-        u8 key_event[6] = {key, event};
-        uart_write_blocking(uart0, key_event, 6);
+        handle_key_event(e.key, e.event);
     }
 }
 
-void parse_inputs()
+void __not_in_flash_func(handle_events)()
 {
-    for (u32 i = 0; i < GP_COUNT; ++i)
+    // The slave is a pure sensor: it sends its key state and drops its events, the master does everything else
+    // Dropping them also means it won't replay stale ones if it becomes the master
+    if (!is_master)
     {
-#ifdef KIBO_LEFT
-        update_input(i, gp_get(get_gp_left(i)));
-#else
-        update_input(i, gp_get(get_gp_right(i)));
-#endif
+        event_queue_clear();
+        send_uart();
+        return;
     }
+
+    update_remote_holds(remote_side());
+    handle_key_events();
 }
 
-void handle_events()
+void handle_repeat()
 {
-    for (u32 i = 0; i < GP_COUNT; ++i)
+    // Only the master sends reports, a half that just lost the role stops repeating
+    if (!is_master)
     {
-        key_events event = get_event(i);
-        if (event != event_RELEASED)
+        key_repeat_stop();
+        return;
+    }
+
+    const u8* keycodes = key_repeat_poll();
+    if (keycodes != NULL)
+    {
+        report_tap(repeat_key, keycodes);
+    }
+}
+
+void handle_uart()
+{
+    link_frame frame;
+    while (link_receive(&frame))
+    {
+        switch (frame.type)
         {
-#ifdef KIBO_LEFT
-            const u8* keycodes = get_keycodes_left(i, event);
-#else
-            const u8* keycodes = get_keycodes_right(i, event);
-#endif
-            if (keycodes[0] == HID_KEY_NONE)
+        case link_HELLO: role_receive_hello(&frame); break;
+
+        case link_STATE_KEYFRAME:
+        case link_STATE_DELTA:
+            // Only the master turns key events into reports
+            if (!is_master)
             {
-                continue;
+                break;
             }
 
-            if (is_master)
+            debug_led_on();
+            key_bits state;
+            if (frame.type == link_STATE_KEYFRAME && frame.len == KEY_STATE_BYTES)
             {
-                // If it's a layer change, handle it internally
-                if (keycodes[0] == HID_KEY_GOTO_LAYER)
-                {
-                    change_layer(keycodes[1]);
-                    continue;
-                }
-
-                // Send actual keycodes to the computer via USB
-                send_hid_report(keycodes);
+                key_state_read(frame.payload, &state);
+                update_remote_state(remote_side(), &state);
             }
-            else
+            else if (frame.type == link_STATE_DELTA)
             {
-                // Send them to the master half
-                send_uart(i, event);
+                half_state(remote_side(), &state);
+                key_state_apply_delta(&state, frame.payload, frame.len);
+                update_remote_state(remote_side(), &state);
             }
+
+            // Handle them right away, so a press and its release in the same batch are both seen
+            handle_key_events();
+            break;
+
+        default: break;
         }
     }
 }
 
-void handle_uart()
+#ifdef KIBO_CONSOLE
+void console_link(const char* args)
+{
+    console_printf(
+        "role %s, %s half, peer %s, lost %u times\r\n", is_master ? "master" : "slave", is_left ? "left" : "right", peer_seen ? "seen" : "missing",
+        peer_losses
+    );
+    console_printf("sent %u received %u crc errors %u\r\n", link_counters.frames_sent, link_counters.frames_received, link_counters.crc_errors);
+    console_printf(
+        "retransmits %u nacks %u/%u dropped %u lost %u\r\n", link_counters.retransmits, link_counters.nacks_sent, link_counters.nacks_received,
+        link_counters.frames_dropped, link_counters.frames_lost
+    );
+    console_printf("rtt %u/%u/%u us\r\n", link_counters.rtt_min, link_rtt_avg(), link_counters.rtt_max);
+}
+
+void console_scan(const char* args)
 {
-    if (uart_is_readable(uart0))
+    if (strcmp(args, "reset") == 0)
     {
-        // Get the bytes from the uart
-        static u8 key_info[6];
-        uart_read_blocking(uart0, key_info, 6);
-
-        // // Ignore if nothing to read
-        // if (key_info[0] == HID_KEY_NONE)
-        // {
-        //     return;
-        // }
-
-        // Received keycodes come from the other keyboard half
-#ifdef KIBO_LEFT
-        const u8* keycodes = get_keycodes_right(key_info[0], key_info[1]);
-#else
-        const u8* keycodes = get_keycodes_left(key_info[0], key_info[1]);
-#endif
+        scan_governor_reset_stats();
+        return;
+    }
+
+    console_printf("%s\r\n", governor_state_names[governor_state]);
+    for (u32 i = 0; i < governor_MAX; ++i)
+    {
+        console_printf("%s: %u frames, %u us\r\n", governor_state_names[i], governor_frames[i], governor_periods[i]);
+    }
+}
+
+void console_health(const char* args)
+{
+    if (strcmp(args, "reset") == 0)
+    {
+        key_health_reset();
+        return;
+    }
+    if (strcmp(args, "save") == 0)
+    {
+        storage_save();
+        return;
+    }
 
-        debug_led_on();
+    console_printf("key presses bounces/press max_bounce_us chatters ghosts debounce_ms\r\n");
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        const u32 k = key_position(local_side(), i);
+        const key_health* health = &key_healths[k];
+        const u32 bounces = health->presses ? health->bounce_edges * 100 / health->presses : 0;
+        const u32 window = key_debounce_window(k) ? key_debounce_window(k) : ms_to_down;
+        console_printf(
+            "%2u %u %u.%02u %u %u %u %u\r\n", k, health->presses, bounces / 100, bounces % 100, health->max_bounce, health->chatters, health->ghosts,
+            window
+        );
+    }
+    console_printf("%u saves, %u erases, %u records per erase\r\n", storage_saves, storage_erases, FLASH_SECTOR_SIZE / storage_slot_size);
+}
 
-        // If it's a layer change, handle it internally
-        if (keycodes[0] == HID_KEY_GOTO_LAYER)
+void console_boot(const char* args)
+{
+    for (u32 i = 0; i < boot_MAX; ++i)
+    {
+        if (boot_times[i] == 0)
         {
-            change_layer(keycodes[1]);
-            return;
+            console_printf("%s: not yet\r\n", boot_stage_names[i]);
+            continue;
         }
+        console_printf("%s: %u us\r\n", boot_stage_names[i], boot_times[i]);
+    }
+}
 
-        // For actual keycodes, send them to the computer via USB
-        send_hid_report(keycodes);
+void console_power(const char* args)
+{
+    console_printf(
+        "host %s, remote wakeup %s, %s at %u kHz\r\n", power_host_suspended ? "suspended" : "awake", power_remote_wakeup ? "allowed" : "denied",
+        power_asleep ? "asleep" : "awake", clock_get_hz(clk_sys) / 1000
+    );
+    console_printf("%u wakes, latency %u us, max %u us\r\n", power_wakes, power_wake_latency, power_wake_latency_max);
+}
+
+void console_watchdog(const char* args)
+{
+    console_printf("reset by %s, %u hangs since power on\r\n", reset_cause_names[reset_cause], loop_watchdog_hangs());
+    if (reset_cause == reset_HANG)
+    {
+        console_printf("hung in %s\r\n", hang_where < stage_MAX ? profiler_stage_names[hang_where] : "?");
     }
 }
+#endif
 
 //-----------------------------------------------------------------------------+
 // TinyUSB HID callbacks
 //-----------------------------------------------------------------------------+
 
 // Callback: report sent successfully
-void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len) {}
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+    report_complete();
+    power_report_sent();
+}
 
 // Callback: received get_report control request
-uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen) { return 0; }
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
+{
+    // Diagnostics are read by the host as feature reports
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_TRACE)
+    {
+        return trace_read_report(buffer, reqlen);
+    }
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_STATS)
+    {
+        return profiler_read_report(buffer, reqlen);
+    }
+
+    return 0;
+}
 
 // Callback: received set_report control request
-void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize) {}
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize)
+{
+    // Writing the stats report clears them
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_STATS)
+    {
+        profiler_reset();
+    }
+}
 
 //-----------------------------------------------------------------------------+
 // Device callbacks
 //-----------------------------------------------------------------------------+
 
 // Callback: device mounted successfully
-void tud_mount_cb(void) {}
+void tud_mount_cb(void)
+{
+    boot_stamp(boot_MOUNTED);
+    report_mounted();
+    role_update();
+}
 
 // Callback: device unmounted successfully
-void tud_umount_cb(void) {}
-
-// Callback: connection suspended
-void tud_suspend_cb(bool remote_wakeup_en)
+void tud_umount_cb(void)
 {
-    // Automatically resume the connection
-    tud_remote_wakeup();
+    report_drop();
+    power_host_suspend(false, false);
+    role_update();
 }
 
+// Callback: connection suspended
+// Both halves go to sleep from power_update(), the host is woken up by a key (see power.h)
+void tud_suspend_cb(bool remote_wakeup_en) { power_host_suspend(true, remote_wakeup_en); }
+
 // Callback: connection resumed
-void tud_resume_cb(void) {}
+void tud_resume_cb(void) { power_host_suspend(false, false); }
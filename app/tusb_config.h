@@ -92,13 +92,24 @@
 
 //------------- CLASS -------------//
 #define CFG_TUD_HID               1
+#ifdef KIBO_CONSOLE
+#define CFG_TUD_CDC               1
+#else
 #define CFG_TUD_CDC               0
+#endif
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_VENDOR            0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE    16
+#define CFG_TUD_HID_EP_BUFSIZE    64
+
+// CDC FIFO size of TX and RX, the console keeps its own buffer on top
+#define CFG_TUD_CDC_RX_BUFSIZE    64
+#define CFG_TUD_CDC_TX_BUFSIZE    64
+
+// CDC Endpoint transfer buffer size
+#define CFG_TUD_CDC_EP_BUFSIZE    64
 
 #ifdef __cplusplus
  }
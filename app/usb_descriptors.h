@@ -31,7 +31,56 @@ enum
   REPORT_ID_MOUSE,
   REPORT_ID_CONSUMER_CONTROL,
   REPORT_ID_GAMEPAD,
+  REPORT_ID_TRACE,
+  REPORT_ID_STATS,
+  REPORT_ID_NKRO,
   REPORT_ID_COUNT
 };
 
+// Payload sizes of the diagnostic feature reports, report ID excluded
+#define TRACE_REPORT_SIZE 62
+#define STATS_REPORT_SIZE 50
+
+// Keys 0 to NKRO_KEY_COUNT - 1 of the NKRO report's bitmap, enough for every key but the rarely used ones past F24
+#define NKRO_KEY_COUNT 128
+
+// Keyboard reporting every key as one bit, after a byte of modifiers like the boot keyboard
+#define TUD_HID_REPORT_DESC_NKRO(...) \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+    HID_USAGE      ( HID_USAGE_DESKTOP_KEYBOARD ), \
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+      /* Report ID if any */ \
+      __VA_ARGS__ \
+      /* 8 bits Modifier Keys (Shift, Control, Alt) */ \
+      HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD ), \
+        HID_USAGE_MIN    ( 224 ), \
+        HID_USAGE_MAX    ( 231 ), \
+        HID_LOGICAL_MIN  ( 0 ), \
+        HID_LOGICAL_MAX  ( 1 ), \
+        HID_REPORT_COUNT ( 8 ), \
+        HID_REPORT_SIZE  ( 1 ), \
+        HID_INPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        /* One bit per key */ \
+        HID_USAGE_MIN    ( 0 ), \
+        HID_USAGE_MAX    ( NKRO_KEY_COUNT - 1 ), \
+        HID_REPORT_COUNT ( NKRO_KEY_COUNT ), \
+        HID_REPORT_SIZE  ( 1 ), \
+        HID_INPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+    HID_COLLECTION_END
+
+// Vendor defined feature report, used by host tools to read diagnostics
+#define TUD_HID_REPORT_DESC_DIAGNOSTIC(report_size, ...) \
+    HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2 ), \
+    HID_USAGE        ( 0x01 ), \
+    HID_COLLECTION   ( HID_COLLECTION_APPLICATION ), \
+      /* Report ID if any */ \
+      __VA_ARGS__ \
+      HID_USAGE        ( 0x02 ), \
+      HID_LOGICAL_MIN  ( 0x00 ), \
+      HID_LOGICAL_MAX_N( 0xff, 2 ), \
+      HID_REPORT_SIZE  ( 8 ), \
+      HID_REPORT_COUNT ( report_size ), \
+      HID_FEATURE      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+    HID_COLLECTION_END
+
 #endif /* USB_DESCRIPTORS_H_ */
@@ -0,0 +1,228 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "types.h"
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *  Notes:
+ *  Runs a fuzz target where libFuzzer isn't available (e.g. gcc), see host/CMakeLists.txt.
+ *  Arguments are files or directories of inputs, every one is run, e.g. the regression corpus.
+ *  -runs=N then runs N random mutations of them (bit flips, byte changes, insertions, truncations),
+ *  from -seed=S (1 by default) so a run can be repeated. It isn't guided, libFuzzer finds more.
+ *  Each input runs in its own process from a fresh boot, a failing one is replayed alone by passing it,
+ *  failing mutations are kept as crash-<seed>-<run> in the working directory.
+ */
+
+#define DRIVER_MAX_INPUT 4096U
+#define DRIVER_MAX_INPUTS 1024U
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+typedef struct driver_input_STRUCT
+{
+    char* path;
+    u8* data;
+    u32 size;
+} driver_input;
+
+static driver_input driver_inputs[DRIVER_MAX_INPUTS];
+static u8 driver_mutant[DRIVER_MAX_INPUT];
+static u32 driver_input_count = 0;
+static u64 driver_rng = 1;
+
+static u32 driver_random(u32 n)
+{
+    // xorshift64
+    driver_rng ^= driver_rng << 13;
+    driver_rng ^= driver_rng >> 7;
+    driver_rng ^= driver_rng << 17;
+    return n == 0 ? 0 : (u32)(driver_rng % n);
+}
+
+static void driver_load(const char* path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        fprintf(stderr, "%s: can't be read\n", path);
+        exit(2);
+    }
+
+    if (S_ISDIR(info.st_mode))
+    {
+        struct dirent** entries;
+        const int count = scandir(path, &entries, NULL, alphasort);
+        for (int i = 0; i < count; ++i)
+        {
+            if (entries[i]->d_name[0] != '.')
+            {
+                char child[4096];
+                snprintf(child, sizeof(child), "%s/%s", path, entries[i]->d_name);
+                driver_load(child);
+            }
+            free(entries[i]);
+        }
+        free(count >= 0 ? entries : NULL);
+        return;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL || driver_input_count == DRIVER_MAX_INPUTS)
+    {
+        fprintf(stderr, "%s: can't be read\n", path);
+        exit(2);
+    }
+
+    driver_input* input = &driver_inputs[driver_input_count++];
+    input->path = strdup(path);
+    input->data = malloc(DRIVER_MAX_INPUT);
+    input->size = fread(input->data, 1, DRIVER_MAX_INPUT, file);
+    fclose(file);
+}
+
+// True if the target returned normally, sanitizer reports abort the process
+static bool driver_run(const u8* data, u32 size)
+{
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        _exit(LLVMFuzzerTestOneInput(data, size));
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static u32 driver_mutate(u8* data, u32 size)
+{
+    const u32 changes = 1 + driver_random(8);
+    for (u32 i = 0; i < changes; ++i)
+    {
+        switch (driver_random(5))
+        {
+        case 0:
+            if (size > 0)
+            {
+                data[driver_random(size)] ^= 1 << driver_random(8);
+            }
+            break;
+        case 1:
+            if (size > 0)
+            {
+                data[driver_random(size)] = driver_random(256);
+            }
+            break;
+        case 2:
+            if (size < DRIVER_MAX_INPUT)
+            {
+                const u32 at = driver_random(size + 1);
+                memmove(&data[at + 1], &data[at], size - at);
+                data[at] = driver_random(256);
+                ++size;
+            }
+            break;
+        case 3:
+            if (size > 0)
+            {
+                const u32 at = driver_random(size);
+                memmove(&data[at], &data[at + 1], size - at - 1);
+                --size;
+            }
+            break;
+        default: size = driver_random(size + 1); break;
+        }
+    }
+
+    return size;
+}
+
+int main(int argc, char** argv)
+{
+    u32 runs = 0;
+    u64 seed = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+        {
+            runs = strtoul(&argv[i][6], NULL, 10);
+        }
+        else if (strncmp(argv[i], "-seed=", 6) == 0)
+        {
+            seed = strtoull(&argv[i][6], NULL, 10);
+        }
+        else
+        {
+            driver_load(argv[i]);
+        }
+    }
+
+    u32 failures = 0;
+    for (u32 i = 0; i < driver_input_count; ++i)
+    {
+        if (!driver_run(driver_inputs[i].data, driver_inputs[i].size))
+        {
+            fprintf(stderr, "%s failed\n", driver_inputs[i].path);
+            ++failures;
+        }
+    }
+
+    driver_rng = seed ? seed : 1;
+    for (u32 run = 0; run < runs && driver_input_count > 0; ++run)
+    {
+        const driver_input* input = &driver_inputs[driver_random(driver_input_count)];
+        memcpy(driver_mutant, input->data, input->size);
+        const u32 size = driver_mutate(driver_mutant, input->size);
+        if (driver_run(driver_mutant, size))
+        {
+            continue;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "crash-%llu-%u", seed, run);
+        FILE* file = fopen(name, "wb");
+        if (file != NULL)
+        {
+            fwrite(driver_mutant, 1, size, file);
+            fclose(file);
+        }
+        fprintf(stderr, "run %u failed, input kept as %s\n", run, name);
+        ++failures;
+    }
+
+    printf("%u inputs, %u runs, %u failures\n", driver_input_count, runs, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "host.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Notes:
+ *  Fuzzes a half's own keys: GPIO levels go through parse_inputs() and debounce, the event queue and
+ *  handle_key_event(), then the reports (master) or the key state sent over the link (slave).
+ *  The first byte sets up the half: bit 0 right instead of left, bit 1 plugged in a host (the master).
+ *  Then every two bytes are a GPIO change: the first has the key index (modulo GP_COUNT) in its low
+ *  7 bits and the level in the top one, the second is how long the pins then stay as they are,
+ *  in 50 us steps below 0xF0 and 100 ms steps from there, so bounces and holds are both reachable.
+ *  Once the trace is over every key is released, and after a while nothing may still be held.
+ */
+
+#define FUZZ_SETTLE_US 2000000U
+
+static void fuzz_run_for(u64 us)
+{
+    const u64 until = host_time + us;
+    do
+    {
+        host_step();
+    } while (host_time < until);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size < 1)
+    {
+        return 0;
+    }
+
+    const sides side = data[0] & 1 ? side_RIGHT : side_LEFT;
+    host_boot(side, data[0] & 2);
+    host_step();
+
+    for (size_t i = 1; i + 1 < size; i += 2)
+    {
+        host_key(side, (data[i] & 0x7F) % GP_COUNT, data[i] & 0x80);
+        fuzz_run_for(data[i + 1] < 0xF0 ? data[i + 1] * 50ULL : (data[i + 1] - 0xEFULL) * 100000);
+    }
+
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        host_key(side, i, false);
+    }
+    fuzz_run_for(FUZZ_SETTLE_US);
+
+    // A key still down, or still in the last report, would be stuck
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        if (key_is_down(key_position(side, i)))
+        {
+            __builtin_trap();
+        }
+    }
+    for (u32 i = 0; i < host_usb_state.report_len; ++i)
+    {
+        if (host_usb_state.report[i] != 0)
+        {
+            __builtin_trap();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "host.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Notes:
+ *  Fuzzes what the master does with whatever comes over the link: link_receive(), then role_receive_hello()
+ *  or update_remote_state() and the key events it queues, down to the USB reports.
+ *  The input is a list of operations, the low 2 bits of their first byte pick one, the other 6 are n:
+ *  0: the next n bytes as is, framing and CRC included
+ *  1: a frame of type n, the next byte is its length and the payload follows, with a valid CRC
+ *  2: a key state frame, keyframe if n is odd else delta, with the sequence number the master expects,
+ *     the next byte is its length and the payload follows
+ *  3: n + 1 main loop iterations, or if n is 63 change_layer() to the next byte
+ *     (GOTO_LAYER targets come from the layout, this stands in for a bad one)
+ *  The master runs one main loop iteration after each operation.
+ */
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    host_boot(side_LEFT, true);
+    host_step();
+
+    size_t i = 0;
+    while (i < size)
+    {
+        const u8 op = data[i] & 3;
+        const u8 n = data[i] >> 2;
+        ++i;
+
+        if (op == 0)
+        {
+            const size_t len = n < size - i ? n : size - i;
+            loopback_put(&data[i], len);
+            i += len;
+        }
+        else if (op == 3 && n == 63)
+        {
+            if (i < size)
+            {
+                change_layer(data[i++]);
+            }
+        }
+        else if (op == 3)
+        {
+            for (u32 k = 0; k < n; ++k)
+            {
+                host_step();
+            }
+        }
+        else
+        {
+            const size_t want = i < size ? data[i++] : 0;
+            const size_t len = want < size - i ? want : size - i;
+            if (op == 1)
+            {
+                host_peer_send(n, &data[i], len);
+            }
+            else
+            {
+                host_peer_send_reliable(n & 1 ? link_STATE_KEYFRAME : link_STATE_DELTA, &data[i], len);
+            }
+            i += len;
+        }
+
+        host_step();
+    }
+
+    return 0;
+}
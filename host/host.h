@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+/*
+ *  Notes:
+ *  The whole firmware, built for a host against the stubs of host/stubs, with the loopback link.
+ *  A test powers a half up with host_boot(), then steps its main loop with update(): each step
+ *  waits like the scan governor would, so time moves by one scan period.
+ *  Keys are pressed through their GPIO (host_key()), and the other half is played through the link
+ *  (host_peer_*()), so everything from the pins or the wire to the USB reports is the firmware's own code.
+ */
+
+#define main kibo_main
+#include "main.c"
+#undef main
+
+#ifdef KEY_MATRIX
+#error "The host build drives one GPIO per key, build it with a layout that isn't a matrix"
+#endif
+
+static u8 host_peer_seq = 0;  // Next sequence number of the other half's reliable frames
+
+// Power on, the half has a host if its USB cable is plugged in one
+void host_boot(sides side, bool has_host)
+{
+    host_reset();
+    host_flash_reset();
+    host_usb_reset();
+    host_gpio_drive(HANDEDNESS_PIN, side != side_LEFT);
+    host_gpio_drive(ROLE_VBUS_PIN, has_host);
+    host_usb_plug(has_host);
+    host_peer_seq = 0;
+
+    init();
+}
+
+void host_key(sides side, u32 i, bool is_down)
+{
+    if (i < GP_COUNT && get_gp(side, i) != GP_NONE)
+    {
+        host_gpio_drive(get_gp(side, i), is_down);
+    }
+}
+
+// Frames from the other half, with a valid CRC
+void host_peer_send(u8 type, const u8* payload, u32 len)
+{
+    u8 frame[LINK_MAX_PAYLOAD + 4] = {LINK_SOF, type, len};
+    len = len > LINK_MAX_PAYLOAD ? LINK_MAX_PAYLOAD : len;
+    frame[2] = len;
+    memcpy(&frame[3], payload, len);
+
+    u8 crc = 0;
+    for (u32 i = 1; i < len + 3; ++i)
+    {
+        crc = link_crc8(crc, frame[i]);
+    }
+    frame[len + 3] = crc;
+
+    loopback_put(frame, len + 4);
+}
+
+void host_peer_send_reliable(u8 type, const u8* payload, u32 len)
+{
+    u8 numbered[LINK_MAX_PAYLOAD] = {host_peer_seq++};
+    len = len > LINK_MAX_PAYLOAD - 1 ? LINK_MAX_PAYLOAD - 1 : len;
+    memcpy(&numbered[1], payload, len);
+    host_peer_send(type, numbered, len + 1);
+}
+
+void host_peer_hello(sides side, bool has_host)
+{
+    const u8 flags = (side == side_LEFT ? ROLE_IS_LEFT : 0) | (has_host ? ROLE_HAS_HOST | ROLE_HAS_VBUS : 0);
+    host_peer_send(link_HELLO, &flags, 1);
+}
+
+// What the half sent, the other half reads it all but doesn't answer
+void host_peer_drain()
+{
+    u8 bytes[LOOPBACK_SIZE];
+    while (loopback_take(bytes, sizeof(bytes)) != 0)
+    {
+    }
+}
+
+// Things that must hold whatever happened, a fuzzer traps on them like on a sanitizer report
+void host_check()
+{
+    if (host_watchdog_expired() || get_layer() >= LAYER_COUNT)
+    {
+        __builtin_trap();
+    }
+}
+
+void host_step()
+{
+    update();
+    host_peer_drain();
+    host_check();
+}
+
+#endif  // HOST_H
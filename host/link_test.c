@@ -0,0 +1,326 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "link.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Runs the link protocol (see link.h) over the loopback transport, the test plays the other half:
+ *  it reads what the link sends, drops or corrupts some of it, and answers by hand.
+ *  Steps share the link's state and run in order, each one starts where the previous one left it.
+ */
+
+#define TEST_MAX_FRAMES 32U
+
+typedef struct wire_frame_STRUCT
+{
+    u8 type;
+    u8 len;
+    u8 payload[LINK_MAX_PAYLOAD];
+} wire_frame;
+
+static u32 test_failures = 0;
+static wire_frame wire[TEST_MAX_FRAMES];  // What the link sent since the last wire_read()
+static u32 wire_count = 0;
+
+#define CHECK(condition) test_check(condition, #condition, __LINE__)
+
+static void test_check(bool is_ok, const char* condition, int line)
+{
+    if (!is_ok)
+    {
+        printf("link_test.c:%d: %s\n", line, condition);
+        ++test_failures;
+    }
+}
+
+// Frames the link sent, the CRC of each is checked
+static void wire_read()
+{
+    u8 bytes[LOOPBACK_SIZE];
+    const u32 count = loopback_take(bytes, sizeof(bytes));
+
+    wire_count = 0;
+    for (u32 i = 0; i + 3 < count && wire_count < TEST_MAX_FRAMES;)
+    {
+        wire_frame* frame = &wire[wire_count++];
+        CHECK(bytes[i] == LINK_SOF);
+        frame->type = bytes[i + 1];
+        frame->len = bytes[i + 2];
+        memcpy(frame->payload, &bytes[i + 3], frame->len);
+
+        u8 crc = 0;
+        for (u32 j = i + 1; j < i + 3 + frame->len; ++j)
+        {
+            crc = link_crc8(crc, bytes[j]);
+        }
+        CHECK(bytes[i + 3 + frame->len] == crc);
+        i += frame->len + 4;
+    }
+}
+
+// Number of frames of that type read, and the first byte of the last one
+static u32 wire_find(u8 type, u8* first)
+{
+    u32 found = 0;
+    for (u32 i = 0; i < wire_count; ++i)
+    {
+        if (wire[i].type == type)
+        {
+            *first = wire[i].payload[0];
+            ++found;
+        }
+    }
+
+    return found;
+}
+
+static void peer_send(u8 type, const u8* payload, u32 len, bool is_corrupt)
+{
+    u8 frame[LINK_MAX_PAYLOAD + 4] = {LINK_SOF, type, len};
+    memcpy(&frame[3], payload, len);
+
+    u8 crc = 0;
+    for (u32 i = 1; i < len + 3; ++i)
+    {
+        crc = link_crc8(crc, frame[i]);
+    }
+    frame[len + 3] = is_corrupt ? crc ^ 1 : crc;
+
+    loopback_put(frame, len + 4);
+}
+
+static void peer_send_byte(u8 type, u8 byte) { peer_send(type, &byte, 1, false); }
+
+static void test_tick_after(u32 us)
+{
+    host_advance_us(us);
+    link_tick();
+}
+
+static u32 test_in_flight() { return (u8)(link_next_seq - link_base); }
+
+static void test_boot_sync()
+{
+    // Sent once the link has been up for a retransmit timeout, like a SYNC that went unanswered
+    link_init();
+    test_tick_after(LINK_RETRANSMIT_US);
+    wire_read();
+
+    u8 seq = 0xFF;
+    CHECK(wire_find(link_SYNC, &seq) == 1 && seq == 0);
+
+    // Until it is acknowledged it is sent again
+    test_tick_after(LINK_RETRANSMIT_US);
+    wire_read();
+    CHECK(wire_find(link_SYNC, &seq) == 1);
+
+    peer_send_byte(link_ACK, 0xFF);
+    link_frame frame;
+    CHECK(!link_receive(&frame));
+    test_tick_after(LINK_RETRANSMIT_US);
+    wire_read();
+    CHECK(wire_find(link_SYNC, &seq) == 0);
+}
+
+static void test_in_order()
+{
+    const u8 payload[] = {1, 2};
+    for (u32 i = 0; i < 3; ++i)
+    {
+        CHECK(link_send_reliable(link_STATE_DELTA, payload, sizeof(payload)));
+    }
+    wire_read();
+
+    u8 seq = 0xFF;
+    CHECK(wire_find(link_STATE_DELTA, &seq) == 3 && seq == 2);
+    CHECK(wire[0].len == sizeof(payload) + 1 && wire[0].payload[1] == 1 && wire[0].payload[2] == 2);
+
+    // One cumulative ACK for the three
+    host_advance_us(500);
+    peer_send_byte(link_ACK, 2);
+    link_frame frame;
+    link_receive(&frame);
+    CHECK(test_in_flight() == 0);
+    CHECK(link_counters.rtt_count == 1 && link_counters.rtt_min == 500);
+}
+
+static void test_drop_and_retransmit()
+{
+    const u32 retransmits = link_counters.retransmits;
+    const u8 payload[] = {3};
+    link_send_reliable(link_STATE_DELTA, payload, 1);
+    link_send_reliable(link_STATE_DELTA, payload, 1);
+
+    // Both lost on the way, nothing happens before the timeout
+    wire_read();
+    test_tick_after(LINK_RETRANSMIT_US - 1);
+    wire_read();
+    CHECK(wire_count == 0);
+
+    test_tick_after(1);
+    wire_read();
+    u8 seq = 0;
+    CHECK(wire_find(link_STATE_DELTA, &seq) == 2 && seq == 4);
+    CHECK(link_counters.retransmits == retransmits + 2);
+
+    peer_send_byte(link_ACK, 4);
+    link_frame frame;
+    link_receive(&frame);
+    CHECK(test_in_flight() == 0);
+}
+
+static void test_nack()
+{
+    const u8 payload[] = {4};
+    for (u32 i = 0; i < 3; ++i)
+    {
+        link_send_reliable(link_STATE_DELTA, payload, 1);
+    }
+    wire_read();
+
+    // 5 arrived, 6 didn't: 6 and 7 are sent again right away
+    peer_send_byte(link_NACK, 6);
+    link_frame frame;
+    link_receive(&frame);
+    CHECK(link_base == 6);
+    wire_read();
+    CHECK(wire_count == 2 && wire[0].payload[0] == 6 && wire[1].payload[0] == 7);
+
+    peer_send_byte(link_ACK, 7);
+    link_receive(&frame);
+    CHECK(test_in_flight() == 0);
+}
+
+static void test_give_up()
+{
+    const u8 payload[] = {5};
+    link_send_reliable(link_STATE_DELTA, payload, 1);
+    CHECK(!link_gave_up());
+
+    // Never acknowledged: sent once, retried LINK_MAX_RETRIES times, then given up on
+    for (u32 i = 0; i <= LINK_MAX_RETRIES; ++i)
+    {
+        wire_read();
+        CHECK(wire_count == 1);
+        test_tick_after(LINK_RETRANSMIT_US);
+    }
+    link_tick();
+    wire_read();
+
+    CHECK(link_counters.frames_lost == 1);
+    CHECK(test_in_flight() == 0);
+    CHECK(link_gave_up());
+    CHECK(!link_gave_up());
+
+    // The SYNC tells where the sequence resumes, frames sent meanwhile follow it
+    u8 seq = 0;
+    CHECK(wire_find(link_SYNC, &seq) == 1 && seq == 9);
+    link_send_reliable(link_STATE_KEYFRAME, payload, 1);
+    wire_read();
+    CHECK(wire_find(link_STATE_KEYFRAME, &seq) == 1 && seq == 9);
+
+    peer_send_byte(link_ACK, 8);
+    peer_send_byte(link_ACK, 9);
+    link_frame frame;
+    link_receive(&frame);
+    test_tick_after(LINK_RETRANSMIT_US);
+    wire_read();
+    CHECK(wire_count == 0);
+}
+
+static void test_receive()
+{
+    link_frame frame;
+    const u8 first[] = {0, 0xAA};
+    peer_send(link_STATE_DELTA, first, sizeof(first), false);
+    CHECK(link_receive(&frame) && frame.type == link_STATE_DELTA && frame.len == 1 && frame.payload[0] == 0xAA);
+    CHECK(!link_receive(&frame));
+    wire_read();
+    u8 seq = 0xFF;
+    CHECK(wire_find(link_ACK, &seq) == 1 && seq == 0);
+
+    // A gap is NACKed once, what follows it isn't delivered
+    const u8 third[] = {2, 0xBB};
+    const u8 fourth[] = {3, 0xCC};
+    peer_send(link_STATE_DELTA, third, sizeof(third), false);
+    peer_send(link_STATE_DELTA, fourth, sizeof(fourth), false);
+    CHECK(!link_receive(&frame));
+    wire_read();
+    CHECK(wire_find(link_NACK, &seq) == 1 && seq == 1);
+
+    // A duplicate is acknowledged again, but not delivered twice
+    peer_send(link_STATE_DELTA, first, sizeof(first), false);
+    CHECK(!link_receive(&frame));
+    wire_read();
+    CHECK(wire_find(link_ACK, &seq) == 1 && seq == 0);
+
+    // The sender gave up on 1 to 4 and resumes at 5
+    peer_send_byte(link_SYNC, 5);
+    const u8 sixth[] = {5, 0xDD};
+    peer_send(link_STATE_DELTA, sixth, sizeof(sixth), false);
+    CHECK(link_receive(&frame) && frame.payload[0] == 0xDD);
+    wire_read();
+    CHECK(wire_find(link_ACK, &seq) == 2 && seq == 5);
+}
+
+static void test_corruption()
+{
+    link_frame frame;
+    const u32 crc_errors = link_counters.crc_errors;
+
+    const u8 seventh[] = {6, 0xEE};
+    peer_send(link_STATE_DELTA, seventh, sizeof(seventh), true);
+    CHECK(!link_receive(&frame));
+    CHECK(link_counters.crc_errors == crc_errors + 1);
+
+    // Noise and a length that can't be right, the parser finds the next frame
+    const u8 noise[] = {0x00, LINK_SOF, link_STATE_DELTA, LINK_MAX_PAYLOAD + 1, 0x42};
+    loopback_put(noise, sizeof(noise));
+    peer_send(link_STATE_DELTA, seventh, sizeof(seventh), false);
+    CHECK(link_receive(&frame) && frame.payload[0] == 0xEE);
+}
+
+int main()
+{
+    host_reset();
+
+    test_boot_sync();
+    test_in_order();
+    test_drop_and_retransmit();
+    test_nack();
+    test_give_up();
+    test_receive();
+    test_corruption();
+
+    printf("%u failures\n", test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
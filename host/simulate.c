@@ -0,0 +1,142 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Types keys on the host build and writes what a host would capture, in the format of
+ *  tools/hid_timing.py: one JSON line per input report or trace feature report, e.g.
+ *    simulate L1 L2 R7 | tools/hid_timing.py analyze -
+ *    simulate --hold=400 L3 | tools/hid_timing.py replay -
+ *  The left half is the master, its keys are pressed through their GPIO. The right half's come over
+ *  the link as keyframes, with its hellos, like the other half would send them.
+ *  Each key is held --hold ms then released, --gap ms before the next one. The trace is read every
+ *  SIMULATE_TRACE_MS like record does, times are the host build's own, from reset.
+ */
+
+#define SIMULATE_TRACE_MS 50U
+
+static key_bits simulate_peer_state;
+static u64 simulate_next_hello = 0;
+static u64 simulate_next_trace = 0;
+
+static void simulate_print(const char* kind, u8 report_id, const u8* data, u32 len)
+{
+    printf("{\"t\": %llu, \"%s\": \"%02x", (unsigned long long)host_time, kind, report_id);
+    for (u32 i = 0; i < len; ++i)
+    {
+        printf("%02x", data[i]);
+    }
+    printf("\"}\n");
+}
+
+static void simulate_on_report(uint8_t report_id, const uint8_t* report, uint16_t len) { simulate_print("input", report_id, report, len); }
+
+// Like record: the ring is drained, a report with fewer entries than fit means it is empty
+static void simulate_read_trace()
+{
+    u8 buffer[TRACE_REPORT_SIZE];
+    while (tud_hid_get_report_cb(0, REPORT_ID_TRACE, HID_REPORT_TYPE_FEATURE, buffer, sizeof(buffer)) > 0 && buffer[0] != 0)
+    {
+        simulate_print("trace", REPORT_ID_TRACE, buffer, sizeof(buffer));
+        if (buffer[0] < TRACE_ENTRIES_PER_REPORT)
+        {
+            break;
+        }
+    }
+}
+
+static void simulate_run_for(u64 us)
+{
+    const u64 until = host_time + us;
+    while (host_time < until)
+    {
+        if (host_time >= simulate_next_hello)
+        {
+            host_peer_hello(side_RIGHT, false);
+            simulate_next_hello = host_time + ROLE_HELLO_INTERVAL * 1000;
+        }
+        if (host_time >= simulate_next_trace)
+        {
+            simulate_read_trace();
+            simulate_next_trace = host_time + SIMULATE_TRACE_MS * 1000;
+        }
+        host_step();
+    }
+}
+
+static void simulate_key(sides side, u32 i, bool is_down)
+{
+    if (side == side_LEFT)
+    {
+        host_key(side, i, is_down);
+        return;
+    }
+
+    u8 payload[KEY_STATE_BYTES];
+    key_bits_set(&simulate_peer_state, i, is_down);
+    key_state_write(&simulate_peer_state, payload);
+    host_peer_send_reliable(link_STATE_KEYFRAME, payload, KEY_STATE_BYTES);
+}
+
+int main(int argc, char** argv)
+{
+    u32 hold_ms = 30;
+    u32 gap_ms = 30;
+
+    host_boot(side_LEFT, true);
+    host_usb_state.on_report = simulate_on_report;
+    simulate_run_for(100000);
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        char side_name = 0;
+        u32 i = 0;
+        if (sscanf(argv[arg], "--hold=%u", &hold_ms) == 1 || sscanf(argv[arg], "--gap=%u", &gap_ms) == 1)
+        {
+            continue;
+        }
+        if (sscanf(argv[arg], "%c%u", &side_name, &i) != 2 || (side_name != 'L' && side_name != 'R') || i >= GP_COUNT)
+        {
+            fprintf(stderr, "usage: simulate [--hold=ms] [--gap=ms] <L0-L%u|R0-R%u>...\n", GP_COUNT - 1, GP_COUNT - 1);
+            return 1;
+        }
+
+        const sides side = side_name == 'L' ? side_LEFT : side_RIGHT;
+        simulate_key(side, i, true);
+        simulate_run_for(hold_ms * 1000ULL);
+        simulate_key(side, i, false);
+        simulate_run_for(gap_ms * 1000ULL);
+    }
+
+    // Until the trace entries of the last keys are done (see trace.h)
+    simulate_run_for(TRACE_PENDING_US + SIMULATE_TRACE_MS * 2000);
+    return 0;
+}
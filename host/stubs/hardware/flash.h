@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HOST_HARDWARE_FLASH_H
+#define HOST_HARDWARE_FLASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  The whole flash is an array, XIP_BASE maps it so the firmware reads it like memory-mapped flash.
+ *  Programming can only clear bits, like the real one, so writing a page twice without an erase shows.
+ */
+
+#define FLASH_PAGE_SIZE (1U << 8)
+#define FLASH_SECTOR_SIZE (1U << 12)
+#define PICO_FLASH_SIZE_BYTES (2U * 1024 * 1024)
+
+static uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+static uint32_t host_flash_erases = 0;
+
+#define XIP_BASE ((uintptr_t)host_flash)
+
+void host_flash_reset()
+{
+    memset(host_flash, 0xFF, sizeof(host_flash));
+    host_flash_erases = 0;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    memset(&host_flash[flash_offs], 0xFF, count);
+    ++host_flash_erases;
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        host_flash[flash_offs + i] &= data[i];
+    }
+}
+
+#endif  // HOST_HARDWARE_FLASH_H
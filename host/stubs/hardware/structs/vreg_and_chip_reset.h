@@ -0,0 +1,43 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HOST_HARDWARE_STRUCTS_VREG_AND_CHIP_RESET_H
+#define HOST_HARDWARE_STRUCTS_VREG_AND_CHIP_RESET_H
+
+#include <stdint.h>
+
+#define VREG_AND_CHIP_RESET_CHIP_RESET_HAD_RUN_BITS 0x00010000U
+
+typedef struct
+{
+    volatile uint32_t vreg;
+    volatile uint32_t bod;
+    volatile uint32_t chip_reset;
+} vreg_and_chip_reset_hw_t;
+
+static vreg_and_chip_reset_hw_t host_vreg_and_chip_reset;
+static vreg_and_chip_reset_hw_t* const vreg_and_chip_reset_hw = &host_vreg_and_chip_reset;
+
+#endif  // HOST_HARDWARE_STRUCTS_VREG_AND_CHIP_RESET_H
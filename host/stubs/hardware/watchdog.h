@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HOST_HARDWARE_WATCHDOG_H
+#define HOST_HARDWARE_WATCHDOG_H
+
+#include "pico/stdlib.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The watchdog doesn't reset the host, host_watchdog_expired() tells a test the loop would have hung
+typedef struct
+{
+    volatile uint32_t ctrl;
+    volatile uint32_t load;
+    volatile uint32_t reason;
+    volatile uint32_t scratch[8];
+    volatile uint32_t tick;
+} watchdog_hw_t;
+
+static watchdog_hw_t host_watchdog;
+static watchdog_hw_t* const watchdog_hw = &host_watchdog;
+static uint32_t host_watchdog_timeout = 0;  // ms, 0 until enabled
+static uint64_t host_watchdog_fed = 0;
+
+bool watchdog_caused_reboot() { return false; }
+
+bool watchdog_enable_caused_reboot() { return false; }
+
+void watchdog_update() { host_watchdog_fed = host_time; }
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug)
+{
+    host_watchdog_timeout = delay_ms;
+    watchdog_update();
+}
+
+bool host_watchdog_expired() { return host_watchdog_timeout != 0 && host_time - host_watchdog_fed > (uint64_t)host_watchdog_timeout * 1000; }
+
+#endif  // HOST_HARDWARE_WATCHDOG_H
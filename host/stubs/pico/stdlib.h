@@ -0,0 +1,249 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Just enough of the Pico SDK for the firmware to run on a host (see host/CMakeLists.txt).
+ *  Everything is one translation unit like the firmware, so the stubs are defined here too.
+ *  Time only moves when the firmware waits (sleep_us(), best_effort_wfe_or_timeout()) or a test calls
+ *  host_advance_us(), alarms fire on the way, as an interrupt would between two instructions.
+ *  Input pins read what a test drives with host_gpio_drive(), until then they read their pull,
+ *  down as after a reset unless gpio_pull_up() was called.
+ */
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void* user_data);
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+#define GPIO_IN 0
+#define GPIO_OUT 1
+#define GPIO_IRQ_EDGE_FALL 0x4U
+#define GPIO_IRQ_EDGE_RISE 0x8U
+#define HOST_GPIO_COUNT 30U
+#define HOST_ALARM_COUNT 8U
+
+#define __not_in_flash(group)
+#define __not_in_flash_func(f) f
+
+typedef struct host_alarm_STRUCT
+{
+    alarm_callback_t callback;
+    void* user_data;
+    uint64_t time;
+} host_alarm;
+
+static uint64_t host_time = 0;  // us since reset
+static uint32_t host_gpio_driven = 0;  // Pins a test drives, the others float
+static uint32_t host_gpio_levels = 0;  // Levels driven by a test
+static uint32_t host_gpio_outputs = 0;
+static uint32_t host_gpio_out_levels = 0;
+static uint32_t host_gpio_pull_ups = 0;
+static uint32_t host_gpio_irq_masks[HOST_GPIO_COUNT];
+static gpio_irq_callback_t host_gpio_irq_callback = NULL;
+static host_alarm host_alarms[HOST_ALARM_COUNT];
+
+static uint32_t host_gpio_level_all()
+{
+    const uint32_t inputs = (host_gpio_driven & host_gpio_levels) | (~host_gpio_driven & host_gpio_pull_ups);
+    return (host_gpio_outputs & host_gpio_out_levels) | (~host_gpio_outputs & inputs);
+}
+
+// Fires the alarms due until then, in order, and stops the clock there
+void host_advance_to(uint64_t time)
+{
+    while (1)
+    {
+        host_alarm* next = NULL;
+        for (uint32_t i = 0; i < HOST_ALARM_COUNT; ++i)
+        {
+            if (host_alarms[i].callback != NULL && host_alarms[i].time <= time && (next == NULL || host_alarms[i].time < next->time))
+            {
+                next = &host_alarms[i];
+            }
+        }
+        if (next == NULL)
+        {
+            break;
+        }
+
+        if (next->time > host_time)
+        {
+            host_time = next->time;
+        }
+        const int64_t again = next->callback((alarm_id_t)(next - host_alarms) + 1, next->user_data);
+        if (again > 0)
+        {
+            next->time += again;
+        }
+        else if (again < 0)
+        {
+            next->time = host_time - again;
+        }
+        else
+        {
+            next->callback = NULL;
+        }
+    }
+
+    if (time > host_time)
+    {
+        host_time = time;
+    }
+}
+
+void host_advance_us(uint64_t us) { host_advance_to(host_time + us); }
+
+// Drives an input pin like a key or a cable would, and raises its edge interrupt
+void host_gpio_drive(uint gpio, bool level)
+{
+    const uint32_t before = host_gpio_level_all();
+    host_gpio_driven |= 1U << gpio;
+    host_gpio_levels = level ? host_gpio_levels | (1U << gpio) : host_gpio_levels & ~(1U << gpio);
+    const uint32_t after = host_gpio_level_all();
+
+    const uint32_t edge = ((before ^ after) >> gpio) & 1 ? (level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL) : 0;
+    if ((host_gpio_irq_masks[gpio] & edge) && host_gpio_irq_callback != NULL)
+    {
+        host_gpio_irq_callback(gpio, edge);
+    }
+}
+
+// Power on: the clock, pins and alarms start over
+void host_reset()
+{
+    host_time = 0;
+    host_gpio_driven = 0;
+    host_gpio_levels = 0;
+    host_gpio_outputs = 0;
+    host_gpio_out_levels = 0;
+    host_gpio_pull_ups = 0;
+    memset(host_gpio_irq_masks, 0, sizeof(host_gpio_irq_masks));
+    host_gpio_irq_callback = NULL;
+    memset(host_alarms, 0, sizeof(host_alarms));
+}
+
+uint32_t time_us_32() { return (uint32_t)host_time; }
+
+uint64_t time_us_64() { return host_time; }
+
+absolute_time_t get_absolute_time() { return host_time; }
+
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+
+bool time_reached(absolute_time_t t) { return host_time >= t; }
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+
+void sleep_us(uint64_t us) { host_advance_us(us); }
+
+void sleep_ms(uint32_t ms) { host_advance_us((uint64_t)ms * 1000); }
+
+void busy_wait_us_32(uint32_t us) { host_advance_us(us); }
+
+void tight_loop_contents() {}
+
+// Nothing wakes the core early but the alarms, edges only come from a test
+bool best_effort_wfe_or_timeout(absolute_time_t timeout)
+{
+    host_advance_to(timeout);
+    return true;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void* user_data, bool fire_if_past)
+{
+    for (uint32_t i = 0; i < HOST_ALARM_COUNT; ++i)
+    {
+        if (host_alarms[i].callback == NULL)
+        {
+            host_alarms[i] = (host_alarm){callback, user_data, host_time + us};
+            return (alarm_id_t)i + 1;
+        }
+    }
+
+    return -1;
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void* user_data, bool fire_if_past)
+{
+    return add_alarm_in_us((uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    if (alarm_id <= 0 || alarm_id > (alarm_id_t)HOST_ALARM_COUNT || host_alarms[alarm_id - 1].callback == NULL)
+    {
+        return false;
+    }
+
+    host_alarms[alarm_id - 1].callback = NULL;
+    return true;
+}
+
+void gpio_init(uint gpio)
+{
+    host_gpio_outputs &= ~(1U << gpio);
+    host_gpio_out_levels &= ~(1U << gpio);
+}
+
+void gpio_set_dir(uint gpio, bool out) { host_gpio_outputs = out ? host_gpio_outputs | (1U << gpio) : host_gpio_outputs & ~(1U << gpio); }
+
+void gpio_set_dir_out_masked(uint32_t mask) { host_gpio_outputs |= mask; }
+
+void gpio_set_dir_in_masked(uint32_t mask) { host_gpio_outputs &= ~mask; }
+
+void gpio_put(uint gpio, bool value) { host_gpio_out_levels = value ? host_gpio_out_levels | (1U << gpio) : host_gpio_out_levels & ~(1U << gpio); }
+
+void gpio_pull_up(uint gpio) { host_gpio_pull_ups |= 1U << gpio; }
+
+void gpio_pull_down(uint gpio) { host_gpio_pull_ups &= ~(1U << gpio); }
+
+void gpio_disable_pulls(uint gpio) { host_gpio_pull_ups &= ~(1U << gpio); }
+
+bool gpio_get(uint gpio) { return (host_gpio_level_all() >> gpio) & 1; }
+
+uint32_t gpio_get_all() { return host_gpio_level_all(); }
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+    host_gpio_irq_masks[gpio] = enabled ? host_gpio_irq_masks[gpio] | event_mask : host_gpio_irq_masks[gpio] & ~event_mask;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+    host_gpio_irq_callback = callback;
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+}
+
+#endif  // HOST_PICO_STDLIB_H
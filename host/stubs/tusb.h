@@ -0,0 +1,146 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HOST_TUSB_H
+#define HOST_TUSB_H
+
+#include "class/hid/hid.h"
+#include "pico/stdlib.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  The device stack as the firmware sees it, with a host that polls the HID endpoint every
+ *  HOST_USB_POLL_US: a report is taken by tud_task() once the next poll is due, then completed.
+ *  host_usb_plug() connects a host, it mounts on the next tud_task(), like after enumeration.
+ *  Every report the host gets goes to host_usb_on_report, if a test set it.
+ */
+
+#define CFG_TUSB_MCU 0
+#include "tusb_config.h"
+
+#define HOST_USB_POLL_US 1000U
+#define HOST_USB_REPORT_MAX 64U
+
+typedef void (*host_report_callback_t)(uint8_t report_id, const uint8_t* report, uint16_t len);
+
+typedef struct host_usb_STRUCT
+{
+    bool is_plugged;
+    bool is_mounted;
+    bool is_report_pending;
+    uint8_t report_id;
+    uint8_t report[HOST_USB_REPORT_MAX];
+    uint16_t report_len;
+    uint64_t last_poll;
+    uint32_t reports;
+    host_report_callback_t on_report;
+} host_usb;
+
+static host_usb host_usb_state;
+
+// Implemented by the firmware
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len);
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+
+void host_usb_reset() { memset(&host_usb_state, 0, sizeof(host_usb_state)); }
+
+void host_usb_plug(bool is_plugged) { host_usb_state.is_plugged = is_plugged; }
+
+bool tud_init(uint8_t rhport) { return true; }
+
+void tud_task()
+{
+    if (host_usb_state.is_plugged != host_usb_state.is_mounted)
+    {
+        host_usb_state.is_mounted = host_usb_state.is_plugged;
+        host_usb_state.is_report_pending = false;
+        if (host_usb_state.is_mounted)
+        {
+            tud_mount_cb();
+        }
+        else
+        {
+            tud_umount_cb();
+        }
+    }
+
+    if (!host_usb_state.is_report_pending || host_time - host_usb_state.last_poll < HOST_USB_POLL_US)
+    {
+        return;
+    }
+
+    host_usb_state.last_poll = host_time;
+    host_usb_state.is_report_pending = false;
+    ++host_usb_state.reports;
+    if (host_usb_state.on_report != NULL)
+    {
+        host_usb_state.on_report(host_usb_state.report_id, host_usb_state.report, host_usb_state.report_len);
+    }
+    tud_hid_report_complete_cb(0, host_usb_state.report, host_usb_state.report_len);
+}
+
+bool tud_mounted() { return host_usb_state.is_mounted; }
+
+bool tud_ready() { return host_usb_state.is_mounted; }
+
+bool tud_suspended() { return false; }
+
+bool tud_remote_wakeup() { return false; }
+
+bool tud_hid_ready() { return host_usb_state.is_mounted && !host_usb_state.is_report_pending; }
+
+bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len)
+{
+    if (!tud_hid_ready() || len > HOST_USB_REPORT_MAX)
+    {
+        return false;
+    }
+
+    host_usb_state.is_report_pending = true;
+    host_usb_state.report_id = report_id;
+    host_usb_state.report_len = len;
+    memcpy(host_usb_state.report, report, len);
+    return true;
+}
+
+// The console has nobody to talk to
+bool tud_cdc_connected() { return false; }
+
+uint32_t tud_cdc_available() { return 0; }
+
+uint32_t tud_cdc_read(void* buffer, uint32_t bufsize) { return 0; }
+
+uint32_t tud_cdc_write(void const* buffer, uint32_t bufsize) { return bufsize; }
+
+uint32_t tud_cdc_write_flush() { return 0; }
+
+uint32_t tud_cdc_write_available() { return 64; }
+
+#endif  // HOST_TUSB_H
@@ -0,0 +1,69 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef BOOT_TIME_H
+#define BOOT_TIME_H
+
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  When each step of getting from power up to the first keystroke happened, in us since reset
+ *  (the timer starts counting at reset, so the bootrom and boot2 are included).
+ *  Each stage is stamped once, read them with the console's boot command.
+ */
+
+typedef enum boot_stages_ENUM
+{
+    boot_MAIN,     // main() entered
+    boot_SCAN,     // First scan of the keys done
+    boot_PEER,     // First HELLO from the other half
+    boot_MOUNTED,  // Enumerated by the host
+    boot_REPORT,   // First report received by the host
+    boot_MAX,
+} boot_stages;
+
+static const char* const boot_stage_names[boot_MAX] = {
+    [boot_MAIN] = "main",
+    [boot_SCAN] = "first scan",
+    [boot_PEER] = "peer",
+    [boot_MOUNTED] = "mounted",
+    [boot_REPORT] = "first report",
+};
+
+static u32 boot_times[boot_MAX] = {0};  // 0 until reached
+
+void boot_stamp(boot_stages stage)
+{
+    if (boot_times[stage] == 0)
+    {
+        boot_times[stage] = time_us_32();
+    }
+}
+
+#endif  // BOOT_TIME_H
@@ -0,0 +1,485 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "input_parse.h"
+#include "key_map.h"
+#include "pico/stdlib.h"
+#include "profiler.h"
+#include "trace.h"
+#include "tusb.h"
+#include "types.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Line based shell on the CDC interface, only compiled with KIBO_CONSOLE.
+ *  Output goes to a ring buffer first, and is flushed by small chunks at a limited rate,
+ *  so an open console never takes more than a few microseconds away from the HID path.
+ *  If the ring is full, output is dropped rather than waited for, and a marker says so.
+ *  Nothing is written after the marker until the ring is empty again.
+ *
+ *  Each parameter is checked against its range, then the whole set against console_check_params(),
+ *  a change that leaves them inconsistent is undone.
+ */
+
+#define CONSOLE_OUT_SIZE 1024U  // Must be a power of two
+#define CONSOLE_LINE_SIZE 64U
+#define CONSOLE_FLUSH_BYTES 64U
+#define CONSOLE_FLUSH_INTERVAL_US 1000U
+#define CONSOLE_TRUNCATED "...truncated\r\n"
+
+typedef struct console_param_STRUCT
+{
+    const char* name;
+    u32* value;
+    u32 min;
+    u32 max;
+} console_param;
+typedef struct console_command_STRUCT
+{
+    const char* name;
+    const char* help;
+    void (*run)(const char* args);
+} console_command;
+
+static char console_out[CONSOLE_OUT_SIZE];
+static u32 console_out_head = 0;
+static u32 console_out_tail = 0;
+static u32 console_last_flush = 0;
+static bool console_out_truncated = false;
+
+static char console_line[CONSOLE_LINE_SIZE];
+static u32 console_line_len = 0;
+
+static const console_param* console_app_params = NULL;
+static u32 console_app_param_count = 0;
+static const console_command* console_app_commands = NULL;
+static u32 console_app_command_count = 0;
+
+static const char* const console_event_names[event_MAX] = {
+    [event_UP] = "up",
+    [event_DOWN] = "down",
+    [event_PRESSED] = "pressed",
+    [event_RELEASED] = "released",
+};
+
+//-----------------------------------------------------------------------------+
+// Output
+//-----------------------------------------------------------------------------+
+
+static void console_push(const char* str, u32 len)
+{
+    for (u32 i = 0; i < len; ++i)
+    {
+        console_out[console_out_head++ & (CONSOLE_OUT_SIZE - 1)] = str[i];
+    }
+}
+
+void console_write(const char* str, u32 len)
+{
+    // The marker always has room left for it
+    const u32 room = CONSOLE_OUT_SIZE - (sizeof(CONSOLE_TRUNCATED) - 1) - (console_out_head - console_out_tail);
+    if (console_out_truncated)
+    {
+        return;
+    }
+
+    if (len > room)
+    {
+        console_push(str, room);
+        console_push(CONSOLE_TRUNCATED, sizeof(CONSOLE_TRUNCATED) - 1);
+        console_out_truncated = true;
+        return;
+    }
+
+    console_push(str, len);
+}
+
+void console_printf(const char* format, ...)
+{
+    char buffer[128];
+
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (len > 0)
+    {
+        console_write(buffer, (u32)len < sizeof(buffer) ? (u32)len : sizeof(buffer) - 1);
+    }
+}
+
+static void console_flush()
+{
+    if (console_out_head == console_out_tail || time_us_32() - console_last_flush < CONSOLE_FLUSH_INTERVAL_US)
+    {
+        return;
+    }
+
+    // Nobody is listening, don't let stale output pile up
+    if (!tud_cdc_connected())
+    {
+        console_out_tail = console_out_head;
+        console_out_truncated = false;
+        return;
+    }
+
+    u32 len = console_out_head - console_out_tail;
+    const u32 available = tud_cdc_write_available();
+    if (len > available)
+    {
+        len = available;
+    }
+    if (len > CONSOLE_FLUSH_BYTES)
+    {
+        len = CONSOLE_FLUSH_BYTES;
+    }
+
+    // Only write up to the end of the ring, the rest goes next time
+    const u32 start = console_out_tail & (CONSOLE_OUT_SIZE - 1);
+    if (start + len > CONSOLE_OUT_SIZE)
+    {
+        len = CONSOLE_OUT_SIZE - start;
+    }
+    if (len == 0)
+    {
+        return;
+    }
+
+    console_out_tail += tud_cdc_write(&console_out[start], len);
+    tud_cdc_write_flush();
+    console_last_flush = time_us_32();
+    console_out_truncated &= console_out_tail != console_out_head;
+}
+
+//-----------------------------------------------------------------------------+
+// Built-in commands
+//-----------------------------------------------------------------------------+
+
+static void console_help(const char* args);
+
+static void console_keys(const char* args)
+{
+    for (u32 k = 0; k < KEY_COUNT; ++k)
+    {
+        console_printf("%2u %s\r\n", k, console_event_names[last_key_events[k].event]);
+    }
+    console_printf("queued %u overflows %u\r\n", event_queue_count(), event_queue_overflows);
+}
+
+static void console_debounce(const char* args)
+{
+    console_printf("up %u down %u pressed %u (ms), inputs in us:\r\n", ms_to_up, ms_to_down, ms_to_pressed);
+    for (u32 k = 0; k < KEY_COUNT; ++k)
+    {
+        console_printf("%u%s", key_inputs[k], k + 1 == KEY_COUNT ? "\r\n" : " ");
+    }
+}
+
+// The whole argument as a decimal number, false if it isn't one or doesn't fit in a u32
+static bool console_parse_u32(const char* text, u32* value)
+{
+    if (*text == '\0')
+    {
+        return false;
+    }
+
+    u64 parsed = 0;
+    for (; *text != '\0'; ++text)
+    {
+        if (*text < '0' || *text > '9')
+        {
+            return false;
+        }
+
+        parsed = parsed * 10 + (u32)(*text - '0');
+        if (parsed > 0xFFFFFFFFU)
+        {
+            return false;
+        }
+    }
+
+    *value = (u32)parsed;
+    return true;
+}
+
+static void console_layer(const char* args)
+{
+    if (*args != '\0')
+    {
+        u32 layer = 0;
+        if (!console_parse_u32(args, &layer) || layer >= LAYER_COUNT)
+        {
+            console_printf("usage: layer [0-%u]\r\n", LAYER_COUNT - 1);
+            return;
+        }
+        change_layer(layer);
+    }
+
+    console_printf("layer %u\r\n", cur_layer);
+}
+
+static void console_trace(const char* args)
+{
+    console_printf("key event edge>debounce>queued>complete (us)\r\n");
+    for (u32 n = 0; n < trace_count(); ++n)
+    {
+        const trace_entry* entry = trace_get(n);
+        const u32 queued = (entry->stamped & (1U << trace_QUEUED)) ? entry->time[trace_QUEUED] - entry->time[trace_DEBOUNCE] : 0;
+        const u32 complete = (entry->stamped & (1U << trace_COMPLETE)) ? entry->time[trace_COMPLETE] - entry->time[trace_QUEUED] : 0;
+        console_printf(
+            "%u %s %u %u %u\r\n", entry->key, console_event_names[entry->event],
+            entry->time[trace_DEBOUNCE] - entry->time[trace_EDGE], queued, complete
+        );
+    }
+}
+
+static void console_stats(const char* args)
+{
+    if (strcmp(args, "reset") == 0)
+    {
+        profiler_reset();
+        return;
+    }
+
+    console_printf("stage count min avg max (us)\r\n");
+    for (u32 stage = 0; stage < stage_MAX; ++stage)
+    {
+        const profiler_stats* stats = &profiler_table[stage];
+        console_printf("%s %u %u %u %u\r\n", profiler_stage_names[stage], stats->count, stats->min, profiler_avg(stage), stats->max);
+    }
+}
+
+//-----------------------------------------------------------------------------+
+// Parameters
+//-----------------------------------------------------------------------------+
+
+static const console_param console_params[] = {
+    {"ms_to_up",           &ms_to_up,           1, 1000 },
+    {"ms_to_down",         &ms_to_down,         1, 1000 },
+    {"ms_to_pressed",      &ms_to_pressed,      1, 10000},
+    {"debounce_adaptive",  &debounce_adaptive,  0, 1    },
+    {"debounce_margin_ms", &debounce_margin_ms, 0, 50   },
+    {"debounce_min_ms",    &debounce_min_ms,    1, 255  },
+    {"debounce_max_ms",    &debounce_max_ms,    1, 255  },
+    {"eager_ms",           &eager_ms,           1, 50   },
+};
+
+static const console_param* console_find_param(const char* name, u32 len)
+{
+    for (u32 i = 0; i < sizeof(console_params) / sizeof(console_params[0]); ++i)
+    {
+        if (strlen(console_params[i].name) == len && strncmp(console_params[i].name, name, len) == 0)
+        {
+            return &console_params[i];
+        }
+    }
+    for (u32 i = 0; i < console_app_param_count; ++i)
+    {
+        if (strlen(console_app_params[i].name) == len && strncmp(console_app_params[i].name, name, len) == 0)
+        {
+            return &console_app_params[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Returns why the parameters don't work together, NULL if they do
+static const char* console_check_params()
+{
+    if (ms_to_up >= ms_to_down)
+    {
+        return "ms_to_up must be below ms_to_down";
+    }
+    if (ms_to_pressed < ms_to_down)
+    {
+        return "ms_to_pressed can't be below ms_to_down";
+    }
+    if (debounce_min_ms > debounce_max_ms)
+    {
+        return "debounce_min_ms can't be above debounce_max_ms";
+    }
+
+    return NULL;
+}
+
+static void console_print_param(const console_param* param) { console_printf("%s %u\r\n", param->name, *param->value); }
+
+static void console_get(const char* args)
+{
+    for (u32 i = 0; i < sizeof(console_params) / sizeof(console_params[0]); ++i)
+    {
+        console_print_param(&console_params[i]);
+    }
+    for (u32 i = 0; i < console_app_param_count; ++i)
+    {
+        console_print_param(&console_app_params[i]);
+    }
+}
+
+static void console_set(const char* args)
+{
+    const char* value = strchr(args, ' ');
+    const console_param* param = console_find_param(args, value ? (u32)(value - args) : strlen(args));
+    if (param == NULL || value == NULL)
+    {
+        console_printf("usage: set <param> <value>, see get\r\n");
+        return;
+    }
+
+    u32 new_value = 0;
+    if (!console_parse_u32(value + 1, &new_value) || new_value < param->min || new_value > param->max)
+    {
+        console_printf("%s must be a number in [%u, %u]\r\n", param->name, param->min, param->max);
+        return;
+    }
+
+    const u32 old_value = *param->value;
+    *param->value = new_value;
+
+    const char* error = console_check_params();
+    if (error != NULL)
+    {
+        *param->value = old_value;
+        console_printf("%s\r\n", error);
+        return;
+    }
+
+    console_print_param(param);
+}
+
+static const console_command console_commands[] = {
+    {"help",     "list commands",                       console_help    },
+    {"keys",     "event of every key",                  console_keys    },
+    {"debounce", "debounce timings and counters",       console_debounce},
+    {"layer",    "show the layer, or change it [n]",    console_layer   },
+    {"trace",    "latency of the latest events",        console_trace   },
+    {"stats",    "main loop stage timings [reset]",     console_stats   },
+    {"get",      "list parameters",                     console_get     },
+    {"set",      "change a parameter <param> <value>",  console_set     },
+};
+
+static void console_help(const char* args)
+{
+    for (u32 i = 0; i < sizeof(console_commands) / sizeof(console_commands[0]); ++i)
+    {
+        console_printf("%s: %s\r\n", console_commands[i].name, console_commands[i].help);
+    }
+    for (u32 i = 0; i < console_app_command_count; ++i)
+    {
+        console_printf("%s: %s\r\n", console_app_commands[i].name, console_app_commands[i].help);
+    }
+}
+
+//-----------------------------------------------------------------------------+
+// Shell
+//-----------------------------------------------------------------------------+
+
+static bool console_run(const console_command* commands, u32 count, const char* name, u32 len, const char* args)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        if (strlen(commands[i].name) == len && strncmp(commands[i].name, name, len) == 0)
+        {
+            commands[i].run(args);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void console_execute(char* line)
+{
+    const char* args = strchr(line, ' ');
+    const u32 len = args ? (u32)(args - line) : strlen(line);
+    args = args ? args + 1 : "";
+
+    if (len == 0)
+    {
+        return;
+    }
+
+    if (!console_run(console_commands, sizeof(console_commands) / sizeof(console_commands[0]), line, len, args) &&
+        !console_run(console_app_commands, console_app_command_count, line, len, args))
+    {
+        console_printf("unknown command, try help\r\n");
+    }
+}
+
+// Params and commands owned by the application, they are listed after the built-in ones
+void console_init(const console_param* params, u32 param_count, const console_command* commands, u32 command_count)
+{
+    console_app_params = params;
+    console_app_param_count = param_count;
+    console_app_commands = commands;
+    console_app_command_count = command_count;
+}
+
+// Called once per main loop iteration, runs at most one command
+void console_update()
+{
+    console_flush();
+
+    char c;
+    while (tud_cdc_available() && tud_cdc_read(&c, 1) == 1)
+    {
+        if (c == '\r' || c == '\n')
+        {
+            if (console_line_len == 0)
+            {
+                continue;
+            }
+
+            console_write("\r\n", 2);
+            console_line[console_line_len] = '\0';
+            console_line_len = 0;
+            console_execute(console_line);
+            return;
+        }
+
+        if ((c == '\b' || c == 0x7F) && console_line_len > 0)
+        {
+            --console_line_len;
+            console_write("\b \b", 3);
+        }
+        else if (c >= ' ' && console_line_len < CONSOLE_LINE_SIZE - 1)
+        {
+            console_line[console_line_len++] = c;
+            console_write(&c, 1);
+        }
+    }
+}
+
+#endif  // CONSOLE_H
@@ -47,7 +47,11 @@ void debug_led_toggle()
 
 static struct cooldown_timer debug_led_cdt;
 
-void debug_led_set_interval(u32 interval) { debug_led_cdt.cooldown = interval; }
+void debug_led_set_interval(u32 interval)
+{
+    debug_led_cdt.cooldown = interval;
+    debug_led_cdt.last_update = board_millis();
+}
 
 void debug_led_init()
 {
@@ -26,7 +26,7 @@
 #ifndef DELTA_TIME_H
 #define DELTA_TIME_H
 
-#include "bsp/board.h"
+#include "pico/stdlib.h"
 #include "types.h"
 
 #include <stdbool.h>
@@ -34,16 +34,21 @@
 static u32 last_frame_time = 0;
 static u32 deltatime = 0;
 
-u32 delta_time() { return deltatime; }
+// In microseconds, frames can be much shorter than a millisecond
+u32 __not_in_flash_func(delta_time)() { return deltatime; }
 
-void delta_time_update()
+// Next delta starts now, time that wasn't scanned isn't integrated by debounce
+void delta_time_reset()
 {
-    const u32 cur_frame_time = board_millis();
-    if (last_frame_time != cur_frame_time)
-    {
-        deltatime = cur_frame_time - last_frame_time;
-        last_frame_time = board_millis();
-    }
+    last_frame_time = time_us_32();
+    deltatime = 0;
+}
+
+void __not_in_flash_func(delta_time_update)()
+{
+    const u32 cur_frame_time = time_us_32();
+    deltatime = cur_frame_time - last_frame_time;
+    last_frame_time = cur_frame_time;
 }
 
 #endif  // DELTA_TIME_H
\ No newline at end of file
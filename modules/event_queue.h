@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include "events.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  Every debounced transition is pushed here with its time, and consumers drain them in order,
+ *  so a key that goes down and up again before anyone looked still produces both events.
+ *  Single producer (debounce and the link, both in the main loop) and single consumer: the indices
+ *  only ever move forward on their own side, so no lock is needed even if one side moves to an interrupt.
+ *  A full queue drops the new event and counts it, which the console shows, instead of overwriting.
+ */
+
+#define EVENT_QUEUE_SIZE 64U  // Must be a power of two
+
+typedef struct key_event_STRUCT
+{
+    u8 key;    // Logical key position
+    u8 event;  // key_events
+    u32 time;  // time_us_32() when debounce decided on it
+} key_event;
+
+static key_event event_queue[EVENT_QUEUE_SIZE];
+static volatile u32 event_queue_head = 0;
+static volatile u32 event_queue_tail = 0;
+static u32 event_queue_overflows = 0;
+
+bool __not_in_flash_func(event_queue_push)(u32 key, key_events event, u32 time)
+{
+    const u32 head = event_queue_head;
+    if (head - event_queue_tail == EVENT_QUEUE_SIZE)
+    {
+        ++event_queue_overflows;
+        return false;
+    }
+
+    event_queue[head & (EVENT_QUEUE_SIZE - 1)] = (key_event){key, event, time};
+    event_queue_head = head + 1;
+    return true;
+}
+
+bool __not_in_flash_func(event_queue_pop)(key_event* out)
+{
+    const u32 tail = event_queue_tail;
+    if (tail == event_queue_head)
+    {
+        return false;
+    }
+
+    *out = event_queue[tail & (EVENT_QUEUE_SIZE - 1)];
+    event_queue_tail = tail + 1;
+    return true;
+}
+
+// Drops everything queued, for a half that doesn't turn events into reports
+void event_queue_clear() { event_queue_tail = event_queue_head; }
+
+u32 event_queue_count() { return event_queue_head - event_queue_tail; }
+
+#endif  // EVENT_QUEUE_H
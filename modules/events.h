@@ -40,8 +40,7 @@ typedef enum key_events_ENUM
 } key_events;
 typedef struct event_STRUCT
 {
-    key_events event;
-    bool was_consumed;
+    key_events event;  // Latest one, consumers get every event from event_queue.h
 } event;
 
 #endif  // EVENTS_H
\ No newline at end of file
@@ -0,0 +1,226 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef GAMING_H
+#define GAMING_H
+
+#include "class/hid/hid.h"
+#include "events.h"
+#include "hid_report.h"
+#include "input_parse.h"
+#include "key_map.h"
+#include "role.h"
+#include "trace.h"
+#include "tusb.h"
+#include "types.h"
+#include "usb_descriptors.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  On a gaming layer, keys are reported as held for as long as they are down, instead of being tapped.
+ *  Every change sends the whole state as an NKRO report, so any number of keys can be held at once
+ *  and the host does its own repeat. Debounce turns eager on both halves while it lasts (see input_parse.h).
+ *  A key keeps the combo of the layer it went down on until it goes up.
+ *
+ *  Opposing directions (socd pairs of the layout) held together are resolved before reporting:
+ *  either the last one pressed wins, or neither is reported. Releasing one brings the other back.
+ *  Taps queued before entering go out first, leaving releases everything before taps resume.
+ */
+
+typedef enum socd_modes_ENUM
+{
+    socd_LAST_INPUT,
+    socd_NEUTRAL,
+    socd_MAX,
+} socd_modes;
+
+static u32 socd_mode = socd_LAST_INPUT;
+
+static bool gaming_active = false;
+static bool gaming_dirty = false;  // State changed since the last report
+static bool gaming_changed[KEY_COUNT];  // Keys to trace with the next report
+static const u8* gaming_combos[KEY_COUNT];
+static u32 gaming_orders[KEY_COUNT];  // When each key went down, to know which was last
+static u32 gaming_order = 0;
+
+bool gaming_is_active() { return gaming_active; }
+
+// Called on the master for the events of keys of a gaming layer, GOTO_LAYER excepted
+void __not_in_flash_func(gaming_key_event)(u32 key, key_events event, const u8* keycodes)
+{
+    if (event == event_DOWN)
+    {
+        gaming_combos[key] = keycodes;
+        gaming_orders[key] = ++gaming_order;
+    }
+    else if (event == event_UP && gaming_combos[key] != NULL)
+    {
+        gaming_combos[key] = NULL;
+    }
+    else
+    {
+        return;
+    }
+
+    gaming_changed[key] = true;
+    gaming_dirty = true;
+}
+
+// Whether the other key of one of its socd pairs hides this one
+static bool __not_in_flash_func(gaming_socd_hides)(u32 key)
+{
+    for (u32 i = 0; i < SOCD_COUNT; ++i)
+    {
+        const u8* pair = socd_pairs[i];
+        if (pair[0] != get_layer())
+        {
+            continue;
+        }
+
+        u32 other = 0;
+        if (pair[1] == key)
+        {
+            other = pair[2];
+        }
+        else if (pair[2] == key)
+        {
+            other = pair[1];
+        }
+        else
+        {
+            continue;
+        }
+
+        if (gaming_combos[other] != NULL && (socd_mode == socd_NEUTRAL || gaming_orders[other] > gaming_orders[key]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void __not_in_flash_func(gaming_build)(hid_nkro_report* report)
+{
+    for (u32 k = 0; k < KEY_COUNT; ++k)
+    {
+        const u8* keycodes = gaming_combos[k];
+        if (keycodes == NULL || gaming_socd_hides(k))
+        {
+            continue;
+        }
+
+        for (u32 i = 0; i < KEYS_PER_COMBO && keycodes[i] != HID_KEY_NONE; ++i)
+        {
+            const u8 keycode = keycodes[i];
+            if (keycode >= HID_KEY_CONTROL_LEFT && keycode <= HID_KEY_GUI_RIGHT)
+            {
+                report->modifier |= 1U << (keycode - HID_KEY_CONTROL_LEFT);
+            }
+            else if (keycode < NKRO_KEY_COUNT)
+            {
+                report->keys[keycode / 8] |= 1U << (keycode % 8);
+            }
+        }
+    }
+}
+
+static void gaming_set_active(bool is_active)
+{
+    gaming_active = is_active;
+    set_eager_debounce(is_active, local_side());
+    role_update();  // Tells the slave to follow
+}
+
+// Called once per frame instead of report_update() while it returns true
+bool __not_in_flash_func(gaming_update)()
+{
+    const bool is_gaming = is_master && tud_mounted() && is_gaming_layer();
+
+    if (!gaming_active)
+    {
+        // Taps from the previous layer go out first
+        if (!is_gaming || !report_idle())
+        {
+            return false;
+        }
+        gaming_set_active(true);
+    }
+
+    if (!is_gaming)
+    {
+        for (u32 k = 0; k < KEY_COUNT; ++k)
+        {
+            if (gaming_combos[k] != NULL)
+            {
+                gaming_combos[k] = NULL;
+                gaming_dirty = true;
+            }
+        }
+
+        // Nothing to release to a host that went away
+        if (!tud_mounted())
+        {
+            gaming_dirty = false;
+        }
+    }
+
+    if (gaming_dirty)
+    {
+        report_data* data = report_begin(REPORT_ID_NKRO);
+        if (data != NULL)
+        {
+            const u8 serial = report_tag();
+            gaming_build(&data->nkro);
+            for (u32 k = 0; k < KEY_COUNT; ++k)
+            {
+                if (gaming_changed[k])
+                {
+                    trace_queued(k, serial);
+                    gaming_changed[k] = false;
+                }
+            }
+
+            gaming_dirty = false;
+            report_commit();
+        }
+    }
+    report_flush();
+
+    // Taps resume once the release went out
+    if (!is_gaming && !gaming_dirty && (reports_sent() || !tud_mounted()))
+    {
+        memset(gaming_changed, 0, sizeof(gaming_changed));
+        gaming_set_active(false);
+        return false;
+    }
+
+    return true;
+}
+
+#endif  // GAMING_H
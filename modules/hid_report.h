@@ -0,0 +1,354 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HID_REPORT_H
+#define HID_REPORT_H
+
+#include "boot_time.h"
+#include "bsp/board_api.h"
+#include "class/hid/hid.h"
+#include "trace.h"
+#include "tusb.h"
+#include "types.h"
+#include "usb_descriptors.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Keyboard reports are built in place in one of two aligned buffers, then handed to TinyUSB as is.
+ *  While one buffer is with the endpoint, the next report is built in the other one, and they swap
+ *  when tud_hid_report_complete_cb() says the host got the first. A report that finds the endpoint
+ *  busy stays pending instead of being dropped, report_begin() returns NULL until it went out.
+ *  tud_hid_report() still copies the 8 bytes into the HID class' own endpoint buffer,
+ *  it is the only copy left between the key map and the wire.
+ *
+ *  Key events don't send reports themselves, they queue taps (a combo pressed then released).
+ *  report_update() merges consecutive taps into one press report as long as they share the same
+ *  modifiers, have no key in common and fit in 6 keys, then follows it with an empty release report.
+ *  Only one report can be with the endpoint at a time, so at most one goes out per poll interval,
+ *  and a press and its release always land in different polls, in the order they were queued.
+ *
+ *  Taps wait while the host isn't there yet (enumerating, or suspended), so keys typed right after
+ *  plugging in aren't lost. The ones older than report_tap_ttl_ms by then are dropped instead of
+ *  being typed late. Until the device is mounted their clock doesn't run, it starts at the mount
+ *  (see report_mounted()): a BIOS or a KVM switch can take several seconds to enumerate, and a TTL
+ *  counted from the key would drop what was typed meanwhile.
+ *  Unmounting drops everything (see tud_umount_cb()).
+ *
+ *  Gaming layers bypass the taps and send the full key state as an NKRO bitmap instead (see gaming.h),
+ *  both kinds share the buffers, each one remembers which report it holds.
+ */
+
+typedef enum report_buffer_states_ENUM
+{
+    report_FREE,      // Can be built
+    report_BUILDING,  // Returned by report_begin()
+    report_PENDING,   // Complete, waiting for the endpoint
+    report_INFLIGHT,  // Given to TinyUSB, until the report completes
+} report_buffer_states;
+
+typedef struct hid_nkro_report_STRUCT
+{
+    u8 modifier;
+    u8 keys[NKRO_KEY_COUNT / 8];  // Bit per usage
+} hid_nkro_report;
+
+typedef union report_data_UNION
+{
+    hid_keyboard_report_t keyboard;
+    hid_nkro_report nkro;
+} report_data;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static report_data report_buffers[2];
+static u8 report_ids[2];
+static report_buffer_states report_states[2] = {report_FREE, report_FREE};
+static u32 report_next = 0;  // Buffer the next report is built in
+static u32 report_send = 0;  // Buffer that goes out next, they alternate like report_next
+static u32 report_lost = 0;  // Dropped because the host went away
+static u8 report_serials[2];  // Tags the trace entries of the keys in each buffer
+
+#define REPORT_TAPS_SIZE 32U  // Must be a power of two
+
+typedef struct queued_tap_STRUCT
+{
+    const u8* keycodes;
+    u32 time;  // ms, when it was queued
+    u8 key;
+} queued_tap;
+
+static queued_tap report_taps[REPORT_TAPS_SIZE];
+static u32 report_taps_head = 0;
+static u32 report_taps_tail = 0;
+static u32 report_taps_overflows = 0;
+static bool report_release_due = false;
+static u8 report_serial = 0;
+static u32 report_tap_ttl_ms = 1000;
+
+static u16 __not_in_flash_func(report_size)(u8 report_id) { return report_id == REPORT_ID_NKRO ? sizeof(hid_nkro_report) : sizeof(hid_keyboard_report_t); }
+
+// Clean report to build in, NULL while both buffers are taken
+report_data* __not_in_flash_func(report_begin)(u8 report_id)
+{
+    if (report_states[report_next] != report_FREE)
+    {
+        return NULL;
+    }
+
+    report_states[report_next] = report_BUILDING;
+    report_ids[report_next] = report_id;
+    memset(&report_buffers[report_next], 0, sizeof(report_data));
+    return &report_buffers[report_next];
+}
+
+// Gives the report returned by report_begin() a new serial, for trace_queued()
+u8 __not_in_flash_func(report_tag)()
+{
+    report_serial = report_serial == 0xFF ? 1 : report_serial + 1;
+    report_serials[report_next] = report_serial;
+    return report_serial;
+}
+
+// Adds a combo to a report, modifiers become modifier bits, returns false if a key didn't fit
+bool __not_in_flash_func(report_add_keycodes)(hid_keyboard_report_t* report, const u8* keycodes)
+{
+    bool is_full = false;
+    for (u32 i = 0; i < 6 && keycodes[i] != HID_KEY_NONE; ++i)
+    {
+        const u8 keycode = keycodes[i];
+        if (keycode >= HID_KEY_CONTROL_LEFT && keycode <= HID_KEY_GUI_RIGHT)
+        {
+            report->modifier |= 1U << (keycode - HID_KEY_CONTROL_LEFT);
+            continue;
+        }
+
+        u32 slot = 0;
+        while (slot < 6 && report->keycode[slot] != HID_KEY_NONE && report->keycode[slot] != keycode)
+        {
+            ++slot;
+        }
+
+        if (slot == 6)
+        {
+            is_full = true;
+            continue;
+        }
+        report->keycode[slot] = keycode;
+    }
+
+    return !is_full;
+}
+
+// Sends the oldest pending report if the endpoint is free
+void __not_in_flash_func(report_flush)()
+{
+    if (report_states[report_send] != report_PENDING || !tud_hid_ready())
+    {
+        return;
+    }
+
+    const u8 report_id = report_ids[report_send];
+    if (tud_hid_report(report_id, &report_buffers[report_send], report_size(report_id)))
+    {
+        report_states[report_send] = report_INFLIGHT;
+        report_send ^= 1;
+    }
+}
+
+// Queues the report returned by report_begin()
+void __not_in_flash_func(report_commit)()
+{
+    report_states[report_next] = report_PENDING;
+    report_next ^= 1;
+    report_flush();
+}
+
+// Called from tud_hid_report_complete_cb(), frees the buffer that was sent
+void report_complete()
+{
+    for (u32 i = 0; i < 2; ++i)
+    {
+        if (report_states[i] == report_INFLIGHT)
+        {
+            report_states[i] = report_FREE;
+            trace_complete(report_serials[i]);
+            boot_stamp(boot_REPORT);
+        }
+    }
+
+    report_flush();
+}
+
+// Called from tud_mount_cb(), the taps queued while enumerating get report_tap_ttl_ms from now
+void report_mounted()
+{
+    const u32 now = board_millis();
+    for (u32 n = report_taps_tail; n != report_taps_head; ++n)
+    {
+        report_taps[n & (REPORT_TAPS_SIZE - 1)].time = now;
+    }
+}
+
+// Forgets every report, for when the host won't poll anymore (unmounted or suspended)
+void report_drop()
+{
+    for (u32 i = 0; i < 2; ++i)
+    {
+        if (report_states[i] == report_PENDING || report_states[i] == report_INFLIGHT)
+        {
+            ++report_lost;
+        }
+        report_states[i] = report_FREE;
+    }
+    report_send = report_next;
+
+    report_lost += report_taps_head - report_taps_tail;
+    report_taps_tail = report_taps_head;
+    report_release_due = false;
+}
+
+// Every report went out
+bool reports_sent() { return report_states[0] == report_FREE && report_states[1] == report_FREE; }
+
+bool report_idle() { return reports_sent() && report_taps_head == report_taps_tail; }
+
+// Queues a combo to press and release, returns false if the queue is full
+bool __not_in_flash_func(report_tap)(u32 key, const u8* keycodes)
+{
+    if (report_taps_head - report_taps_tail == REPORT_TAPS_SIZE)
+    {
+        ++report_taps_overflows;
+        return false;
+    }
+
+    report_taps[report_taps_head & (REPORT_TAPS_SIZE - 1)] = (queued_tap){keycodes, board_millis(), key};
+    ++report_taps_head;
+    return true;
+}
+
+// Whether a combo can join a report without changing what the keys already in it mean
+static bool __not_in_flash_func(report_fits)(const hid_keyboard_report_t* report, const u8* keycodes)
+{
+    u8 modifier = 0;
+    u32 free_slots = 0;
+    for (u32 slot = 0; slot < 6; ++slot)
+    {
+        free_slots += report->keycode[slot] == HID_KEY_NONE;
+    }
+
+    for (u32 i = 0; i < 6 && keycodes[i] != HID_KEY_NONE; ++i)
+    {
+        if (keycodes[i] >= HID_KEY_CONTROL_LEFT && keycodes[i] <= HID_KEY_GUI_RIGHT)
+        {
+            modifier |= 1U << (keycodes[i] - HID_KEY_CONTROL_LEFT);
+            continue;
+        }
+
+        for (u32 slot = 0; slot < 6; ++slot)
+        {
+            if (report->keycode[slot] == keycodes[i])
+            {
+                return false;
+            }
+        }
+        if (free_slots == 0)
+        {
+            return false;
+        }
+        --free_slots;
+    }
+
+    return modifier == report->modifier;
+}
+
+// Drops the taps that waited too long for a suspended host, the ones waiting for a mount stay
+static void report_expire_taps()
+{
+    if (!tud_mounted())
+    {
+        return;
+    }
+
+    const u32 now = board_millis();
+    while (report_taps_head != report_taps_tail && now - report_taps[report_taps_tail & (REPORT_TAPS_SIZE - 1)].time > report_tap_ttl_ms)
+    {
+        ++report_taps_tail;
+        ++report_lost;
+    }
+}
+
+// Called once per frame, turns queued taps into reports as buffers free up
+void __not_in_flash_func(report_update)()
+{
+    if (!tud_ready())
+    {
+        report_expire_taps();
+        return;
+    }
+
+    report_flush();
+    if (!report_release_due && report_taps_head == report_taps_tail)
+    {
+        return;
+    }
+
+    report_data* data = report_begin(REPORT_ID_KEYBOARD);
+    if (data == NULL)
+    {
+        return;
+    }
+
+    hid_keyboard_report_t* report = &data->keyboard;
+    const u8 serial = report_tag();
+
+    // An empty report releases everything
+    if (report_release_due)
+    {
+        report_release_due = false;
+        report_commit();
+        return;
+    }
+
+    bool is_first = true;
+    while (report_taps_head != report_taps_tail)
+    {
+        const queued_tap* tap = &report_taps[report_taps_tail & (REPORT_TAPS_SIZE - 1)];
+        if (!is_first && !report_fits(report, tap->keycodes))
+        {
+            break;
+        }
+
+        report_add_keycodes(report, tap->keycodes);
+        trace_queued(tap->key, serial);
+        ++report_taps_tail;
+        is_first = false;
+    }
+
+    report_release_due = true;
+    report_commit();
+}
+
+#endif  // HID_REPORT_H
@@ -27,115 +27,286 @@
 #define INPUT_PARSE_H
 
 #include "delta_time.h"
+#include "event_queue.h"
 #include "events.h"
+#include "key_health.h"
 #include "key_map.h"
+#include "key_state.h"
+#include "trace.h"
 #include "types.h"
 
 #include <stdbool.h>
+#include <string.h>
 
-static u32 key_inputs[GP_COUNT] = {0};
+/*
+ *  Notes:
+ *  Every table here is indexed by logical key position (see key_map.h), so both halves share it.
+ *  Local keys are debounced by update_input(), keys of the other half arrive already debounced.
+ *  Debounce timings are set in ms but integrated in us, since the scan rate can exceed 1 kHz.
+ *  Thresholds are crossed rather than hit exactly, frames don't last a fixed time.
+ *  The integrator stops at the press threshold, so a release takes as long after any hold.
+ *  How long a key has been held is timed from its DOWN instead (key_hold), for both halves.
+ *
+ *  Eager debounce (gaming layers, see gaming.h) reports the first edge right away and then ignores
+ *  the key for eager_ms, so bounces can't turn into events. It trades noise immunity for latency,
+ *  and only knows DOWN and UP, held keys are never PRESSED.
+ */
+
+static u32 key_inputs[KEY_COUNT] = {0};  // us
 static const u32 ms_to_released = 0;
-static const u32 ms_to_up = 10;
-static const u32 ms_to_down = 20;
-static const u32 ms_to_pressed = 300;
+static u32 ms_to_up = 10;
+static u32 ms_to_down = 20;
+static u32 ms_to_pressed = 300;
+
+static event last_key_events[KEY_COUNT];
+static u32 key_hold[KEY_COUNT] = {0};  // us since DOWN
+static u32 key_state[(KEY_COUNT + 31) / 32] = {0};  // Debounced, one bit per key
+
+static bool debounce_eager = false;
+static u32 eager_ms = 5;
+static u32 eager_lockouts[KEY_COUNT] = {0};  // us left before the key is looked at again
+
+bool __not_in_flash_func(key_is_down)(u32 k) { return (key_state[k / 32] >> (k % 32)) & 1; }
+
+static void __not_in_flash_func(set_event)(u32 k, key_events new_event)
+{
+    last_key_events[k].event = new_event;
+    if (new_event != event_RELEASED)
+    {
+        event_queue_push(k, new_event, time_us_32());
+    }
 
-static event last_key_events[GP_COUNT];
+    if (new_event == event_DOWN)
+    {
+        key_state[k / 32] |= 1U << (k % 32);
+        key_hold[k] = 0;
+    }
+    else if (new_event == event_UP)
+    {
+        key_state[k / 32] &= ~(1U << (k % 32));
+    }
+}
+
+// A learned press window keeps the global ratio between the press and release thresholds
+static u32 __not_in_flash_func(down_threshold)(u32 k)
+{
+    const u32 window = key_debounce_window(k);
+    return (window ? window : ms_to_down) * 1000;
+}
+
+static u32 __not_in_flash_func(up_threshold)(u32 k)
+{
+    const u32 window = key_debounce_window(k);
+    return window ? window * ms_to_up * 1000 / ms_to_down : ms_to_up * 1000;
+}
 
-static void update_event(u32 i)
+static void __not_in_flash_func(update_event)(u32 k)
 {
-    if (last_key_events[i].event != event_DOWN && last_key_events[i].event != event_PRESSED && key_inputs[i] == ms_to_down)
+    const key_events last_event = last_key_events[k].event;
+
+    if (last_event != event_DOWN && last_event != event_PRESSED && key_inputs[k] >= down_threshold(k))
     {
-        last_key_events[i].event = event_DOWN;
-        last_key_events[i].was_consumed = false;
+        set_event(k, event_DOWN);
+        trace_debounce(k, event_DOWN);
+        key_health_debounce(k, event_DOWN);
     }
-    else if (last_key_events[i].event == event_DOWN && key_inputs[i] == ms_to_pressed)
+    else if (last_event == event_DOWN && down_threshold(k) + key_hold[k] >= ms_to_pressed * 1000)
     {
-        last_key_events[i].event = event_PRESSED;
-        last_key_events[i].was_consumed = false;
+        set_event(k, event_PRESSED);
+        trace_debounce(k, event_PRESSED);
     }
-    else if (last_key_events[i].event != event_UP && last_key_events[i].event != event_RELEASED && key_inputs[i] == ms_to_up)
+    else if (last_event != event_UP && last_event != event_RELEASED && key_inputs[k] <= up_threshold(k))
     {
-        last_key_events[i].event = event_UP;
-        last_key_events[i].was_consumed = false;
+        set_event(k, event_UP);
+        trace_debounce(k, event_UP);
+        key_health_debounce(k, event_UP);
     }
-    else if (last_key_events[i].event == event_UP && key_inputs[i] == ms_to_released)
+    else if (last_event == event_UP && key_inputs[k] == ms_to_released)
     {
-        last_key_events[i].event = event_RELEASED;
-        last_key_events[i].was_consumed = false;
+        set_event(k, event_RELEASED);
+        trace_debounce(k, event_RELEASED);
     }
 }
 
-void update_input(u32 i, bool is_pressed)
+static void __not_in_flash_func(update_input_eager)(u32 k, bool is_pressed)
 {
-    if (is_pressed)
+    if (eager_lockouts[k] > 0)
     {
-        if (key_inputs[i] < ms_to_pressed)
-        {
-            key_inputs[i] += delta_time();
+        eager_lockouts[k] = delta_time() > eager_lockouts[k] ? 0 : eager_lockouts[k] - delta_time();
+        return;
+    }
 
-            if (key_inputs[i] > ms_to_pressed)
-            {
-                key_inputs[i] = ms_to_pressed;
-            }
-        }
+    if (is_pressed == key_is_down(k))
+    {
+        return;
+    }
+
+    const key_events new_event = is_pressed ? event_DOWN : event_UP;
+    set_event(k, new_event);
+    trace_debounce(k, new_event);
+    key_health_debounce(k, new_event);
+    eager_lockouts[k] = eager_ms * 1000;
+
+    // Nothing left to integrate
+    if (new_event == event_UP)
+    {
+        set_event(k, event_RELEASED);
+    }
+}
+
+void __not_in_flash_func(update_input)(u32 k, bool is_pressed)
+{
+    trace_scan(k, is_pressed);
+    key_health_scan(k, is_pressed);
+
+    if (debounce_eager)
+    {
+        update_input_eager(k, is_pressed);
+        return;
+    }
+
+    // Pressed combos only need the time since DOWN, whatever the key does meanwhile
+    if (last_key_events[k].event == event_DOWN)
+    {
+        key_hold[k] += delta_time();
+    }
+
+    if (is_pressed)
+    {
+        const u32 max_input = down_threshold(k);
+        key_inputs[k] = key_inputs[k] + delta_time() < max_input ? key_inputs[k] + delta_time() : max_input;
     }
     else
     {
-        if (key_inputs[i] > ms_to_released)
+        if (key_inputs[k] > ms_to_released)
         {
-            if (delta_time() > key_inputs[i])
+            if (delta_time() > key_inputs[k])
             {
-                key_inputs[i] = 0;
+                key_inputs[k] = 0;
             }
             else
             {
-                key_inputs[i] -= delta_time();
+                key_inputs[k] -= delta_time();
+            }
+
+            // Raw activity that died out before debounce let it through
+            if (key_inputs[k] == 0 && last_key_events[k].event == event_RELEASED)
+            {
+                key_health_ghost(k);
             }
         }
     }
 
-    update_event(i);
+    update_event(k);
 }
 
-bool input_down(u32 i)
+bool input_pressed(u32 k) { return (last_key_events[k].event == event_PRESSED); }
+
+bool input_released(u32 k) { return (last_key_events[k].event == event_RELEASED); }
+
+// True while any key is held or still debouncing
+bool inputs_busy()
 {
-    if (last_key_events[i].event == event_DOWN && !last_key_events[i].was_consumed)
+    for (u32 i = 0; i < sizeof(key_state) / sizeof(key_state[0]); ++i)
     {
-        last_key_events[i].was_consumed = true;
-        return true;
+        if (key_state[i] != 0)
+        {
+            return true;
+        }
+    }
+
+    for (u32 k = 0; k < KEY_COUNT; ++k)
+    {
+        if (key_inputs[k] != 0 || eager_lockouts[k] != 0)
+        {
+            return true;
+        }
     }
 
     return false;
 }
-bool input_pressed(u32 i) { return (last_key_events[i].event == event_PRESSED); }
 
-bool input_up(u32 i)
+// Both ways, the integrators of the local half restart from the debounced state
+void set_eager_debounce(bool is_eager, sides local)
 {
-    if (last_key_events[i].event == event_UP && !last_key_events[i].was_consumed)
+    if (is_eager == debounce_eager)
     {
-        last_key_events[i].was_consumed = true;
-        return true;
+        return;
     }
+    debounce_eager = is_eager;
 
-    return false;
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        const u32 k = key_position(local, i);
+        const bool is_down = key_is_down(k);
+        key_inputs[k] = !is_eager && is_down ? down_threshold(k) : 0;
+        eager_lockouts[k] = 0;
+
+        // A key held across the switch doesn't get its pressed combo
+        last_key_events[k].event = is_down ? event_PRESSED : event_RELEASED;
+    }
 }
-bool input_released(u32 i) { return (last_key_events[i].event == event_RELEASED); }
 
-key_events get_event(u32 i)
+// Debounced state of one half
+void half_state(sides side, key_bits* out)
 {
-    switch (last_key_events[i].event)
+    memset(out, 0, sizeof(*out));
+    for (u32 i = 0; i < GP_COUNT; ++i)
     {
-    case event_UP:
-    case event_DOWN:
-    case event_PRESSED:
-        if (last_key_events[i].was_consumed)
+        key_bits_set(out, i, key_is_down(key_position(side, i)));
+    }
+}
+
+//-----------------------------------------------------------------------------+
+// Other half
+//-----------------------------------------------------------------------------+
+
+// Applies a new debounced state received from the other half
+void update_remote_state(sides side, const key_bits* state)
+{
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        const u32 k = key_position(side, i);
+        const bool is_down = key_bits_get(state, i);
+        if (is_down == key_is_down(k))
         {
-            return event_RELEASED;
+            continue;
         }
-        last_key_events[i].was_consumed = true;
-        return last_key_events[i].event;
 
-    default: return event_RELEASED;
+        const key_events new_event = is_down ? event_DOWN : event_UP;
+        set_event(k, new_event);
+        trace_remote(k, new_event);
+    }
+}
+
+void reset_remote_state(sides side)
+{
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        const u32 k = key_position(side, i);
+        last_key_events[k] = (event){0};
+        key_hold[k] = 0;
+        key_state[k / 32] &= ~(1U << (k % 32));
+    }
+}
+
+// Called once per main loop iteration, the other half only sends changes so holds are timed here
+void update_remote_holds(sides side)
+{
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        const u32 k = key_position(side, i);
+        if (last_key_events[k].event != event_DOWN)
+        {
+            continue;
+        }
+
+        key_hold[k] += delta_time();
+        if (key_hold[k] >= ms_to_pressed * 1000)
+        {
+            set_event(k, event_PRESSED);
+            trace_remote(k, event_PRESSED);
+        }
     }
 }
 
@@ -0,0 +1,233 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef KEY_HEALTH_H
+#define KEY_HEALTH_H
+
+#include "events.h"
+#include "key_map.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Counts what debouncing hides, to spot switches that are wearing out.
+ *  A transition starts at the first raw edge and ends once the raw level has been quiet for
+ *  HEALTH_SETTLE_US: every other edge in between is a bounce. Ending on quiet rather than on the
+ *  debounced event keeps the measure independent of the debounce window it is used to tune.
+ *  Raw activity that dies out without an event is a ghost, a press that follows a release faster
+ *  than a finger can is chatter.
+ *  Each half only measures its own switches, the tables are persisted by storage.h.
+ *
+ *  Bounce durations also go in a per-key histogram, from which the adaptive debounce picks each
+ *  key's window: its p99 plus a margin, clamped. Keys with too few samples use the global ms_to_down.
+ *  A histogram halves when a bucket saturates, so recent behavior weighs more as a switch ages.
+ */
+
+typedef struct key_health_STRUCT
+{
+    u32 presses;
+    u32 bounce_edges;  // Raw edges beyond the first of each transition
+    u32 max_bounce;    // us, from the first to the last edge of a transition
+    u16 chatters;      // Presses less than health_chatter_ms after the previous release
+    u16 ghosts;        // Raw activity that never became a press
+} key_health;
+
+#define HEALTH_SETTLE_US 16000U
+#define BOUNCE_BUCKETS 16U  // 1 ms each, the last one also holds everything longer
+#define BOUNCE_MIN_SAMPLES 64U
+
+static key_health key_healths[KEY_COUNT];
+static u16 key_bounce_histograms[KEY_COUNT][BOUNCE_BUCKETS];
+static u32 health_chatter_ms = 40;
+
+static u32 debounce_adaptive = 1;
+static u32 debounce_margin_ms = 2;
+static u32 debounce_min_ms = 4;
+static u32 debounce_max_ms = 20;
+static u8 key_bounce_p99[KEY_COUNT];  // ms, 0 until there are enough samples
+
+static bool health_raw[KEY_COUNT];
+static u16 health_edges[KEY_COUNT];  // Edges of the current transition, 0 when settled
+static u32 health_first_edge[KEY_COUNT];
+static u32 health_last_edge[KEY_COUNT];
+static u32 health_last_up[KEY_COUNT];
+
+static void __not_in_flash_func(health_tune)(u32 k)
+{
+    const u16* histogram = key_bounce_histograms[k];
+
+    u32 total = 0;
+    for (u32 b = 0; b < BOUNCE_BUCKETS; ++b)
+    {
+        total += histogram[b];
+    }
+    if (total < BOUNCE_MIN_SAMPLES)
+    {
+        key_bounce_p99[k] = 0;
+        return;
+    }
+
+    const u32 p99_count = total - total / 100;
+    u32 p99 = BOUNCE_BUCKETS;
+    u32 count = 0;
+    for (u32 b = 0; b < BOUNCE_BUCKETS; ++b)
+    {
+        count += histogram[b];
+        if (count >= p99_count)
+        {
+            p99 = b + 1;  // Upper bound of the bucket
+            break;
+        }
+    }
+    key_bounce_p99[k] = p99;
+}
+
+static void __not_in_flash_func(health_end_transition)(u32 k)
+{
+    key_healths[k].bounce_edges += health_edges[k] - 1;
+
+    const u32 bounce = health_last_edge[k] - health_first_edge[k];
+    if (bounce > key_healths[k].max_bounce)
+    {
+        key_healths[k].max_bounce = bounce;
+    }
+
+    u16* histogram = key_bounce_histograms[k];
+    const u32 bucket = bounce / 1000 < BOUNCE_BUCKETS ? bounce / 1000 : BOUNCE_BUCKETS - 1;
+    if (histogram[bucket] == UINT16_MAX)
+    {
+        for (u32 b = 0; b < BOUNCE_BUCKETS; ++b)
+        {
+            histogram[b] /= 2;
+        }
+    }
+    ++histogram[bucket];
+
+    health_edges[k] = 0;
+    health_tune(k);
+}
+
+// Called for every scanned local key
+void __not_in_flash_func(key_health_scan)(u32 k, bool is_pressed)
+{
+    const bool is_edge = is_pressed != health_raw[k];
+    if (!is_edge && health_edges[k] == 0)
+    {
+        return;
+    }
+
+    const u32 now = time_us_32();
+    if (!is_edge)
+    {
+        if (now - health_last_edge[k] >= HEALTH_SETTLE_US)
+        {
+            health_end_transition(k);
+        }
+        return;
+    }
+
+    health_raw[k] = is_pressed;
+    if (health_edges[k] == 0)
+    {
+        health_first_edge[k] = now;
+    }
+    health_last_edge[k] = now;
+
+    if (health_edges[k] < UINT16_MAX)
+    {
+        ++health_edges[k];
+    }
+}
+
+// Called when debounce settles on a new event for a local key
+void __not_in_flash_func(key_health_debounce)(u32 k, key_events event)
+{
+    const u32 now = time_us_32();
+
+    if (event == event_DOWN)
+    {
+        ++key_healths[k].presses;
+        if (key_healths[k].presses > 1 && now - health_last_up[k] < health_chatter_ms * 1000 && key_healths[k].chatters < UINT16_MAX)
+        {
+            ++key_healths[k].chatters;
+        }
+    }
+    else if (event == event_UP)
+    {
+        health_last_up[k] = now;
+    }
+}
+
+// Called when a local key's debounce integrator falls back to zero without it ever being down
+void key_health_ghost(u32 k)
+{
+    if (key_healths[k].ghosts < UINT16_MAX)
+    {
+        ++key_healths[k].ghosts;
+    }
+}
+
+// Press debounce window of a key, in ms, or 0 to use the global one
+u32 __not_in_flash_func(key_debounce_window)(u32 k)
+{
+    if (!debounce_adaptive || key_bounce_p99[k] == 0)
+    {
+        return 0;
+    }
+
+    u32 window = key_bounce_p99[k] + debounce_margin_ms;
+    if (window < debounce_min_ms)
+    {
+        window = debounce_min_ms;
+    }
+    if (window > debounce_max_ms)
+    {
+        window = debounce_max_ms;
+    }
+    return window;
+}
+
+// Called once the histograms are restored
+void key_health_init()
+{
+    for (u32 k = 0; k < KEY_COUNT; ++k)
+    {
+        health_tune(k);
+    }
+}
+
+void key_health_reset()
+{
+    memset(key_healths, 0, sizeof(key_healths));
+    memset(key_bounce_histograms, 0, sizeof(key_bounce_histograms));
+    key_health_init();
+}
+
+#endif  // KEY_HEALTH_H
@@ -28,253 +28,82 @@
 
 #include "bsp/board_api.h"
 #include "events.h"
+#include "pico/stdlib.h"
 #include "tusb.h"
 #include "types.h"
 
 #include <stdbool.h>
-
-#define GP_COUNT 20U
+#include <string.h>
 
 #define KEYS_PER_COMBO 6U
-#define LAYER_COUNT 4U
 #define HID_KEY_GOTO_LAYER 0xA5
 
-static const u32 gp_map_left[GP_COUNT] = {
-    2,  3,  4,  5,  6,  7,   // row 1
-    8,  9,  10, 11, 12, 13,  // row 2
-    14, 15, 16, 17, 18,      // row 3
-    19, 20, 21               // thumb row
-};
+typedef enum sides_ENUM
+{
+    side_LEFT,
+    side_RIGHT,
+    side_MAX,
+} sides;
 
-static const u32 gp_map_right[GP_COUNT] = {
-    7,  2,  3,  4,  5,  6,   // row 1
-    9,  10, 11, 8,  22, 21,  // row 2
-    19, 20, 18, 17, 16,      // row 3
-    15, 14, 13               // thumb row
-};
+// How a key auto-repeats its down combo while held, see key_repeat.h
+typedef enum repeat_modes_ENUM
+{
+    repeat_NONE,
+    repeat_NORMAL,
+    repeat_FAST,
+    repeat_MAX,
+} repeat_modes;
 
-static const u8 key_map_left[LAYER_COUNT][GP_COUNT][event_MAX - 1][KEYS_PER_COMBO] = {
-    // Layer 0
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_2}, [event_DOWN] = {HID_KEY_BACKSPACE, HID_KEY_PERIOD, HID_KEY_C, HID_KEY_O, HID_KEY_M}},
-     {[event_DOWN] = {HID_KEY_Q}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_Q}},
-     {[event_DOWN] = {HID_KEY_W}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_W}},
-     {[event_DOWN] = {HID_KEY_F}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_F}},
-     {[event_DOWN] = {HID_KEY_P}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_P}},
-     {[event_DOWN] = {HID_KEY_B}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_B}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_MINUS}, [event_PRESSED] = {HID_KEY_SHIFT_LEFT, HID_KEY_BACKSLASH}},
-     {[event_DOWN] = {HID_KEY_A}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_A}},
-     {[event_DOWN] = {HID_KEY_R}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_R}},
-     {[event_DOWN] = {HID_KEY_S}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_S}},
-     {[event_DOWN] = {HID_KEY_T}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_T}},
-     {[event_DOWN] = {HID_KEY_G}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_G}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_Z}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_Z}},
-     {[event_DOWN] = {HID_KEY_X}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_X}},
-     {[event_DOWN] = {HID_KEY_C}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_C}},
-     {[event_DOWN] = {HID_KEY_D}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_D}},
-     {[event_DOWN] = {HID_KEY_V}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_V}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_ENTER}},
-     {[event_DOWN] = {HID_KEY_SPACE}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_MINUS}},
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 1}}
-    },
-    // Layer 1
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_ESCAPE}},
-     {[event_DOWN] = {HID_KEY_BRACKET_LEFT, HID_KEY_A}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_BRACKET_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_A}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_3, HID_KEY_8}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_8, HID_KEY_3}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_K, HID_KEY_C}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_K, HID_KEY_U}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_TAB}},
-     {[event_DOWN] = {HID_KEY_APOSTROPHE, HID_KEY_A}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_APOSTROPHE, HID_KEY_SHIFT_LEFT, HID_KEY_A}},
-     {[event_DOWN] = {HID_KEY_APOSTROPHE, HID_KEY_D, HID_KEY_BACKSPACE}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_ALT_RIGHT, HID_KEY_CRSEL_PROPS}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_S}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_D}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_5}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_4}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_Z}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_Y}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_X}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_C}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_V}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_BACKSLASH, HID_KEY_N}},
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_BACKSLASH, HID_KEY_T}},
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 0}}
-    },
-    // Layer 2
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_ESCAPE}},
-     {[event_DOWN] = {HID_KEY_O, HID_KEY_R}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_CRSEL_PROPS}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_3}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_8}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_BRACKET_LEFT, HID_KEY_D, HID_KEY_BACKSPACE}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_CRSEL_PROPS}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_4}},
-     {[event_DOWN] = {HID_KEY_A, HID_KEY_N, HID_KEY_D}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_7}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_MINUS}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_EQUAL}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_EQUAL}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_N, HID_KEY_O, HID_KEY_T}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_1}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_5}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_BRACKET_LEFT, HID_KEY_D, HID_KEY_BACKSPACE}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_SEMICOLON}, [event_PRESSED] = {HID_KEY_EQUAL}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_ENTER}},
-     {[event_DOWN] = {HID_KEY_SPACE}},
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 0}}
-    },
-    // Layer 3
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_F1}},
-     {[event_DOWN] = {HID_KEY_F2}},
-     {[event_DOWN] = {HID_KEY_F3}},
-     {[event_DOWN] = {HID_KEY_F4}},
-     {[event_DOWN] = {HID_KEY_F5}},
-     {[event_DOWN] = {HID_KEY_F6}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_ESCAPE}},
-     {[event_DOWN] = {HID_KEY_M}},
-     {[event_DOWN] = {HID_KEY_Q}},
-     {[event_DOWN] = {HID_KEY_W}},
-     {[event_DOWN] = {HID_KEY_E}},
-     {[event_DOWN] = {HID_KEY_R}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT}},
-     {[event_DOWN] = {HID_KEY_A}},
-     {[event_DOWN] = {HID_KEY_S}},
-     {[event_DOWN] = {HID_KEY_D}},
-     {[event_DOWN] = {HID_KEY_B}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_ENTER}},
-     {[event_DOWN] = {HID_KEY_SPACE}},
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 0}}
-    }
-};
+/*
+ *  Notes:
+ *  Keys are identified by their logical position, which covers both halves:
+ *  [0, GP_COUNT) are the left half's keys, [GP_COUNT, KEY_COUNT) the right half's ones.
+ *  Only pin scanning and the link deal with a half's own index (see key_position()).
+ */
 
-static const u8 key_map_right[LAYER_COUNT][GP_COUNT][event_MAX - 1][KEYS_PER_COMBO] = {
-    // Layer 0
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_J}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_J}},
-     {[event_DOWN] = {HID_KEY_L}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_L}},
-     {[event_DOWN] = {HID_KEY_U}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_U}},
-     {[event_DOWN] = {HID_KEY_Y}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_Y}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_COMMA}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_2}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_9}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_0}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_M}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_M}},
-     {[event_DOWN] = {HID_KEY_N}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_N}},
-     {[event_DOWN] = {HID_KEY_E}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_E}},
-     {[event_DOWN] = {HID_KEY_I}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_I}},
-     {[event_DOWN] = {HID_KEY_O}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_O}},
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_BRACKET_LEFT}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_ALT_RIGHT, HID_KEY_BRACKET_RIGHT}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_K}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_K}},
-     {[event_DOWN] = {HID_KEY_H}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_H}},
-     {[event_DOWN] = {HID_KEY_COMMA}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SEMICOLON}},
-     {[event_DOWN] = {HID_KEY_PERIOD}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_SEMICOLON}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_6}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_1}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 2}},
-     {[event_DOWN] = {HID_KEY_BACKSPACE}},
-     {[event_DOWN] = {HID_KEY_DELETE}}
-    },
-    // Layer 1
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_P}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_ALT_LEFT, HID_KEY_DELETE}},
-     {[event_DOWN] = {HID_KEY_APOSTROPHE, HID_KEY_U}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_APOSTROPHE, HID_KEY_SHIFT_LEFT, HID_KEY_U}},
-     {[event_DOWN] = {HID_KEY_BRACKET_LEFT, HID_KEY_I}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_BRACKET_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_I}},
-     {[event_DOWN] = {HID_KEY_BRACKET_RIGHT, HID_KEY_C}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_BRACKET_RIGHT, HID_KEY_SHIFT_LEFT, HID_KEY_C}},
-     {[event_DOWN] = {HID_KEY_BACKSLASH}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_BACKSLASH}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_F}},
-     {[event_DOWN] = {HID_KEY_BRACKET_LEFT, HID_KEY_E}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_BRACKET_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_E}},
-     {[event_DOWN] = {HID_KEY_SLASH}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_SLASH}},
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_APOSTROPHE}, [event_PRESSED] = {HID_KEY_I}},
-     {[event_DOWN] = {HID_KEY_BRACKET_LEFT, HID_KEY_O}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_BRACKET_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_O}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_5}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_ALT_RIGHT, HID_KEY_BACKSLASH}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_G}},
-     {[event_DOWN] = {HID_KEY_APOSTROPHE, HID_KEY_E}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_APOSTROPHE, HID_KEY_SHIFT_LEFT, HID_KEY_E}},
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_APOSTROPHE}, [event_PRESSED] = {HID_KEY_E}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_7}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_8}},
-     {[event_DOWN] = {HID_KEY_CONTROL_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_ESCAPE}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_BACKSPACE}},
-     {[event_DOWN] = {HID_KEY_DELETE}},
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 2}}
-    },
-    // Layer 2
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_0, HID_KEY_X}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_0, HID_KEY_B}},
-     {[event_DOWN] = {HID_KEY_1}},
-     {[event_DOWN] = {HID_KEY_2}},
-     {[event_DOWN] = {HID_KEY_3}},
-     {[event_DOWN] = {HID_KEY_BACKSLASH}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_BACKSLASH}},
-     {[event_DOWN] = {HID_KEY_SHIFT_LEFT, HID_KEY_9}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_0}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_F}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_PERIOD, HID_KEY_0, HID_KEY_F}},
-     {[event_DOWN] = {HID_KEY_4}},
-     {[event_DOWN] = {HID_KEY_5}},
-     {[event_DOWN] = {HID_KEY_6}},
-     {[event_DOWN] = {HID_KEY_0}},
-     {[event_DOWN] = {HID_KEY_ALT_RIGHT, HID_KEY_APOSTROPHE}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_ALT_RIGHT, HID_KEY_BACKSLASH}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_L}, [event_PRESSED] = {HID_KEY_BACKSPACE, HID_KEY_SHIFT_LEFT, HID_KEY_U, HID_KEY_L}},
-     {[event_DOWN] = {HID_KEY_7}},
-     {[event_DOWN] = {HID_KEY_8}},
-     {[event_DOWN] = {HID_KEY_9}},
-     {[event_DOWN] = {HID_KEY_COMMA}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 3}},
-     {[event_DOWN] = {HID_KEY_BACKSPACE}},
-     {[event_DOWN] = {HID_KEY_PERIOD}}
-    },
-    // Layer 3
-    {// Row 1 (top)
-     {[event_DOWN] = {HID_KEY_F7}},
-     {[event_DOWN] = {HID_KEY_F8}},
-     {[event_DOWN] = {HID_KEY_F9}},
-     {[event_DOWN] = {HID_KEY_F10}},
-     {[event_DOWN] = {HID_KEY_F11}},
-     {[event_DOWN] = {HID_KEY_F12}},
-     // Row 2 (middle)
-     {[event_DOWN] = {HID_KEY_O}},
-     {[event_DOWN] = {HID_KEY_P}},
-     {[event_DOWN] = {HID_KEY_ARROW_UP}},
-     {[event_DOWN] = {HID_KEY_Z}},
-     {[event_DOWN] = {HID_KEY_X}},
-     {[event_DOWN] = {HID_KEY_C}},
-     // Row 3 (bottom)
-     {[event_DOWN] = {HID_KEY_K}},
-     {[event_DOWN] = {HID_KEY_ARROW_LEFT}},
-     {[event_DOWN] = {HID_KEY_ARROW_DOWN}},
-     {[event_DOWN] = {HID_KEY_ARROW_RIGHT}},
-     {[event_DOWN] = {HID_KEY_V}},
-     // Row 4 (thumb)
-     {[event_DOWN] = {HID_KEY_GOTO_LAYER, 2}},
-     {[event_DOWN] = {HID_KEY_BACKSPACE}},
-     {[event_DOWN] = {HID_KEY_DELETE}}
-    }
-};
+#define KEY_COUNT (GP_COUNT * side_MAX)
+#define GP_NONE 0xFFU  // Padding of the pin maps of a half with fewer keys than the other
+
+/*
+ *  Notes:
+ *  The pin maps (used by key_scan.h) and key map are generated at build time from the layout file
+ *  (layouts/kibo40.layout by default, see tools/keymap.py).
+ *  Each key event of each layer holds the index of its combo in key_combos,
+ *  so a combo used by several keys is only stored once.
+ *  key_combos is copied to SRAM at boot, and the tables of the active layer whenever it changes,
+ *  so resolving a key never waits on a flash cache miss.
+ */
+#include "key_map_layout.h"
 
+// Only the master resolves keycodes, so it is the only one that knows the layer
 static u32 cur_layer = 0;
+static u8 layer_actions[KEY_COUNT][event_MAX - 1];  // SRAM copies of the active layer
+static u8 layer_repeats[KEY_COUNT];
+static bool layer_is_gaming = false;
+
+u32 __not_in_flash_func(key_position)(sides side, u32 i) { return side * GP_COUNT + i; }
+
+const u8* __not_in_flash_func(get_keycodes)(u32 key, key_events event) { return key_combos[layer_actions[key][event]]; }
+
+repeat_modes __not_in_flash_func(get_repeat)(u32 key) { return layer_repeats[key]; }
+
+void change_layer(u32 i)
+{
+    if (i >= LAYER_COUNT)
+    {
+        return;
+    }
+
+    cur_layer = i;
+    memcpy(layer_actions, key_actions[i], sizeof(layer_actions));
+    memcpy(layer_repeats, key_repeats[i], sizeof(layer_repeats));
+    layer_is_gaming = layer_gaming[i];
+}
 
-const u32 get_gp_left(u32 i) { return gp_map_left[i]; }
-const u32 get_gp_right(u32 i) { return gp_map_right[i]; }
+void key_map_init() { change_layer(0); }
 
-const u8* get_keycodes_left(u32 i, key_events event) { return key_map_left[cur_layer][i][event]; }
-const u8* get_keycodes_right(u32 i, key_events event) { return key_map_right[cur_layer][i][event]; }
+u32 get_layer() { return cur_layer; }
 
-void change_layer(u32 i) { cur_layer = i; }
+bool is_gaming_layer() { return layer_is_gaming; }
 
 #endif  // KEY_MAP_H
\ No newline at end of file
@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef KEY_REPEAT_H
+#define KEY_REPEAT_H
+
+#include "input_parse.h"
+#include "key_map.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  Typematic repeat of the last key pressed, for keys the layout marks with repeat.
+ *  The timing comes from a hardware alarm, so it doesn't depend on how long a frame takes,
+ *  but reports can't be sent from its interrupt: it only flags a repeat for key_repeat_poll().
+ *  Rates can be faster than the host's own typematic setting, which never kicks in since
+ *  every report is a press immediately followed by a release.
+ */
+
+typedef struct repeat_rate_STRUCT
+{
+    u32 delay;     // ms, from the key press to the first repeat
+    u32 interval;  // ms, between repeats
+} repeat_rate;
+
+static repeat_rate repeat_rates[repeat_MAX] = {
+    [repeat_NORMAL] = {400, 33},
+    [repeat_FAST] = {200, 16},
+};
+
+#define REPEAT_NO_KEY 0xFFFFFFFFU
+
+static u32 repeat_key = REPEAT_NO_KEY;
+static const u8* repeat_keycodes = NULL;
+static repeat_modes repeat_mode = repeat_NONE;
+static alarm_id_t repeat_alarm = 0;
+static volatile bool repeat_due = false;
+
+static int64_t repeat_alarm_cb(alarm_id_t id, void* user_data)
+{
+    repeat_due = true;
+
+    // Positive, so the next one is scheduled from when this one was due and doesn't drift
+    return (int64_t)repeat_rates[repeat_mode].interval * 1000;
+}
+
+void key_repeat_stop()
+{
+    if (repeat_alarm > 0)
+    {
+        cancel_alarm(repeat_alarm);
+        repeat_alarm = 0;
+    }
+
+    repeat_key = REPEAT_NO_KEY;
+    repeat_keycodes = NULL;
+    repeat_due = false;
+}
+
+// Keycodes are those of the layer the key was pressed on, like any other down combo
+void key_repeat_start(u32 key, const u8* keycodes, repeat_modes mode)
+{
+    key_repeat_stop();
+
+    if (mode == repeat_NONE || repeat_rates[mode].interval == 0)
+    {
+        return;
+    }
+
+    repeat_key = key;
+    repeat_keycodes = keycodes;
+    repeat_mode = mode;
+    repeat_alarm = add_alarm_in_ms(repeat_rates[mode].delay, repeat_alarm_cb, NULL, true);
+}
+
+// Keycodes to send again, if a repeat is due
+const u8* key_repeat_poll()
+{
+    if (repeat_key == REPEAT_NO_KEY)
+    {
+        return NULL;
+    }
+
+    // Also covers keys that vanished without an up event, e.g. the other half going away
+    if (!key_is_down(repeat_key))
+    {
+        key_repeat_stop();
+        return NULL;
+    }
+
+    if (!repeat_due)
+    {
+        return NULL;
+    }
+
+    // Repeats that came due several times since the last poll are only sent once, not in a burst
+    repeat_due = false;
+    return repeat_keycodes;
+}
+
+#endif  // KEY_REPEAT_H
@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef KEY_SCAN_H
+#define KEY_SCAN_H
+
+#include "key_map.h"
+#include "key_state.h"
+#include "pico/stdlib.h"
+#include "pin_helper.h"
+#include "scan_governor.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Reads the raw level of every key of a half, as one bit per key (bit i is the half's key i),
+ *  so debounce and everything after it don't know how the keys are wired.
+ *  The layout picks the wiring: one GPIO per key, or a row/column matrix for boards with more keys.
+ *  A half with fewer keys, rows or columns than the other has its maps padded with GP_NONE,
+ *  those keys are never down.
+ */
+
+#ifndef KEY_MATRIX
+
+static const u32* const gp_maps[side_MAX] = {gp_map_left, gp_map_right};
+
+const u32 __not_in_flash_func(get_gp)(sides side, u32 i) { return gp_maps[side][i]; }
+
+void key_scan_init(sides side)
+{
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        if (get_gp(side, i) == GP_NONE)
+        {
+            continue;
+        }
+
+        gp_on(get_gp(side, i));
+        scan_governor_watch(get_gp(side, i));
+    }
+}
+
+void __not_in_flash_func(key_scan)(sides side, key_bits* out)
+{
+    memset(out, 0, sizeof(*out));
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        if (get_gp(side, i) != GP_NONE)
+        {
+            key_bits_set(out, i, gp_get(get_gp(side, i)));
+        }
+    }
+}
+
+#else
+
+/*
+ *  Notes:
+ *  Strobe lines are driven low one at a time and the read lines, pulled up, go low where a key is pressed.
+ *  With col2row diodes (anode on the column) rows are strobed and columns read, row2col is the opposite.
+ *  Strobes are never driven high, a released strobe is an input, so two pressed keys can't short two outputs.
+ *
+ *  Settling budget, per strobe:
+ *  - Falling: the strobe pulls the read lines of pressed keys low through its output driver, in well
+ *    under a microsecond even on long traces, then the input synchronizers take 2 cycles.
+ *    The scan reads after MATRIX_DRIVE_US (2 to 3 us), the time_us_32() tick falling anywhere in it.
+ *  - Rising: a read line that was pulled low comes back up through the weak pull-up only, so after
+ *    each strobe the scan waits until every read line is high again, at most matrix_settle_us.
+ *  Between scans every strobe is held low, so any press makes an edge on a read line and wakes
+ *  the scan governor, like direct pins do. The edges the scan itself makes are ignored.
+ *
+ *  Strobing is done by the CPU, it costs about 3 us per strobe line, well within a 125 us frame.
+ */
+
+#if MATRIX_COL2ROW
+#define MATRIX_STROBES MATRIX_ROWS
+#define MATRIX_READS MATRIX_COLS
+static const u32* const matrix_strobe_maps[side_MAX] = {matrix_rows_left, matrix_rows_right};
+static const u32* const matrix_read_maps[side_MAX] = {matrix_cols_left, matrix_cols_right};
+#else
+#define MATRIX_STROBES MATRIX_COLS
+#define MATRIX_READS MATRIX_ROWS
+static const u32* const matrix_strobe_maps[side_MAX] = {matrix_cols_left, matrix_cols_right};
+static const u32* const matrix_read_maps[side_MAX] = {matrix_rows_left, matrix_rows_right};
+#endif
+
+#define MATRIX_DRIVE_US 2U  // At least, from driving a strobe low to reading, see the notes
+
+static u32 matrix_settle_us = 10;
+static u32 matrix_strobe_mask = 0;
+static u32 matrix_read_mask = 0;
+
+// Key index of a strobe and read line crossing
+static u32 __not_in_flash_func(matrix_key)(u32 strobe, u32 read) { return MATRIX_COL2ROW ? strobe * MATRIX_COLS + read : read * MATRIX_COLS + strobe; }
+
+// busy_wait_us_32() runs from flash, this spins on the timer instead
+// The timer may tick right after start is read, waiting for us + 1 ticks is what makes it at least us
+static void __not_in_flash_func(matrix_wait)(u32 us)
+{
+    const u32 start = time_us_32();
+    while (time_us_32() - start <= us)
+    {
+    }
+}
+
+static void __not_in_flash_func(matrix_settle)()
+{
+    const u32 start = time_us_32();
+    while ((gpio_get_all() & matrix_read_mask) != matrix_read_mask && time_us_32() - start < matrix_settle_us)
+    {
+    }
+}
+
+void key_scan_init(sides side)
+{
+    for (u32 i = 0; i < MATRIX_STROBES; ++i)
+    {
+        const u32 gpio = matrix_strobe_maps[side][i];
+        if (gpio == GP_NONE)
+        {
+            continue;
+        }
+
+        gp_in(gpio);
+        gp_off(gpio);  // Output level once the direction is switched
+        matrix_strobe_mask |= 1U << gpio;
+    }
+
+    for (u32 i = 0; i < MATRIX_READS; ++i)
+    {
+        const u32 gpio = matrix_read_maps[side][i];
+        if (gpio == GP_NONE)
+        {
+            continue;
+        }
+
+        gp_in(gpio);
+        gpio_pull_up(gpio);
+        matrix_read_mask |= 1U << gpio;
+        scan_governor_watch(gpio);
+    }
+
+    gpio_set_dir_out_masked(matrix_strobe_mask);
+}
+
+void __not_in_flash_func(key_scan)(sides side, key_bits* out)
+{
+    const u32* strobes = matrix_strobe_maps[side];
+    const u32* reads = matrix_read_maps[side];
+
+    gpio_set_dir_in_masked(matrix_strobe_mask);
+    matrix_settle();
+
+    memset(out, 0, sizeof(*out));
+    for (u32 s = 0; s < MATRIX_STROBES; ++s)
+    {
+        if (strobes[s] == GP_NONE)
+        {
+            continue;
+        }
+
+        gpio_set_dir_out_masked(1U << strobes[s]);
+        matrix_wait(MATRIX_DRIVE_US);
+        const u32 levels = gpio_get_all();
+        gpio_set_dir_in_masked(1U << strobes[s]);
+
+        for (u32 r = 0; r < MATRIX_READS; ++r)
+        {
+            if (reads[r] != GP_NONE && !(levels & (1U << reads[r])))
+            {
+                key_bits_set(out, matrix_key(s, r), true);
+            }
+        }
+        matrix_settle();
+    }
+
+    gpio_set_dir_out_masked(matrix_strobe_mask);
+    matrix_wait(MATRIX_DRIVE_US);
+    scan_governor_ignore_edges();
+}
+
+#endif
+
+#endif  // KEY_SCAN_H
@@ -0,0 +1,163 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef KEY_STATE_H
+#define KEY_STATE_H
+
+#include "key_map.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Debounced state of a half, one bit per key, in as many bytes as GP_COUNT needs.
+ *  On the link a change is sent as the runs of bits that flipped, KEY_STATE_RUN_BYTES per run:
+ *  [run length - 1 : 3 bits][first key : 5 bits] while a half has at most 32 keys,
+ *  [first key][run length - 1] past that.
+ *  A change that needs more bytes than KEY_STATE_BYTES is sent as a keyframe instead, which is never longer.
+ *  Both are read from whatever the link delivers, bits past GP_COUNT don't belong to a key and are dropped.
+ *  A keyframe has to fit in a reliable frame, which caps a half at (LINK_MAX_PAYLOAD - 1) * 8 keys
+ *  (see tools/keymap.py).
+ */
+
+#define KEY_STATE_BYTES ((GP_COUNT + 7) / 8)
+#define KEY_STATE_WORDS ((GP_COUNT + 31) / 32)
+#define KEY_STATE_MAX_RUN 8U
+#if GP_COUNT <= 32
+#define KEY_STATE_RUN_BYTES 1U
+#else
+#define KEY_STATE_RUN_BYTES 2U
+#endif
+
+// Bit i is the half's key i
+typedef struct key_bits_STRUCT
+{
+    u32 words[KEY_STATE_WORDS];
+} key_bits;
+
+bool __not_in_flash_func(key_bits_get)(const key_bits* bits, u32 i) { return (bits->words[i / 32] >> (i % 32)) & 1; }
+
+void __not_in_flash_func(key_bits_set)(key_bits* bits, u32 i, bool is_set)
+{
+    if (is_set)
+    {
+        bits->words[i / 32] |= 1U << (i % 32);
+    }
+    else
+    {
+        bits->words[i / 32] &= ~(1U << (i % 32));
+    }
+}
+
+bool key_bits_equal(const key_bits* a, const key_bits* b) { return memcmp(a->words, b->words, sizeof(a->words)) == 0; }
+
+void key_state_write(const key_bits* state, u8* out)
+{
+    for (u32 i = 0; i < KEY_STATE_BYTES; ++i)
+    {
+        out[i] = state->words[i / 4] >> (i % 4 * 8);
+    }
+}
+
+void key_state_read(const u8* in, key_bits* state)
+{
+    memset(state, 0, sizeof(*state));
+    for (u32 i = 0; i < GP_COUNT; ++i)
+    {
+        key_bits_set(state, i, (in[i / 8] >> (i % 8)) & 1);
+    }
+}
+
+static void key_state_write_run(u8* out, u32 start, u32 run)
+{
+#if KEY_STATE_RUN_BYTES == 1
+    out[0] = (run - 1) << 5 | start;
+#else
+    out[0] = start;
+    out[1] = run - 1;
+#endif
+}
+
+static void key_state_read_run(const u8* in, u32* start, u32* run)
+{
+#if KEY_STATE_RUN_BYTES == 1
+    *start = in[0] & 0x1F;
+    *run = (in[0] >> 5) + 1;
+#else
+    *start = in[0];
+    *run = (in[1] < KEY_STATE_MAX_RUN ? in[1] : KEY_STATE_MAX_RUN - 1) + 1;
+#endif
+}
+
+// Returns the number of bytes written to out, or 0 if a keyframe is shorter
+u32 key_state_encode_delta(const key_bits* old_state, const key_bits* new_state, u8* out)
+{
+    u32 len = 0;
+    u32 i = 0;
+
+    while (i < GP_COUNT)
+    {
+        if (key_bits_get(old_state, i) == key_bits_get(new_state, i))
+        {
+            ++i;
+            continue;
+        }
+
+        if (len + KEY_STATE_RUN_BYTES > KEY_STATE_BYTES)
+        {
+            return 0;
+        }
+
+        const u32 start = i;
+        while (i < GP_COUNT && i - start < KEY_STATE_MAX_RUN && key_bits_get(old_state, i) != key_bits_get(new_state, i))
+        {
+            ++i;
+        }
+
+        key_state_write_run(&out[len], start, i - start);
+        len += KEY_STATE_RUN_BYTES;
+    }
+
+    return len;
+}
+
+void key_state_apply_delta(key_bits* state, const u8* runs, u32 len)
+{
+    for (u32 i = 0; i + KEY_STATE_RUN_BYTES <= len; i += KEY_STATE_RUN_BYTES)
+    {
+        u32 start = 0;
+        u32 run = 0;
+        key_state_read_run(&runs[i], &start, &run);
+        for (u32 bit = start; bit < start + run && bit < GP_COUNT; ++bit)
+        {
+            key_bits_set(state, bit, !key_bits_get(state, bit));
+        }
+    }
+}
+
+#endif  // KEY_STATE_H
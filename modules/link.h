@@ -0,0 +1,482 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Half-to-half link, every message is a frame:
+ *  [LINK_SOF] [type] [payload length] [payload...] [crc8 of type, length and payload]
+ *  Reception never blocks, bytes are parsed as they arrive and bad frames are skipped.
+ *
+ *  Reliable frames (type >= LINK_FIRST_RELIABLE) start their payload with a sequence number.
+ *  They are delivered in order, exactly once, using go-back-N:
+ *  - The receiver only accepts the next expected sequence number, and acknowledges it (cumulative ACK).
+ *    A gap is answered with a NACK of the expected number, duplicates are acknowledged again.
+ *  - The sender keeps up to LINK_WINDOW frames in flight. A NACK, or no ACK after LINK_RETRANSMIT_US,
+ *    sends everything from the oldest unacknowledged frame again.
+ *  - After LINK_MAX_RETRIES a frame is given up on, with everything queued behind it.
+ *    A SYNC frame then tells the receiver where the sequence resumes. It is also sent at boot.
+ *    Frames that depend on the lost ones are wrong from then on, link_gave_up() tells the sender to
+ *    send something that doesn't (e.g. a keyframe instead of a delta).
+ *
+ *  Bytes go through a transport picked at build time (KIBO_LINK in CMakeLists.txt), each one
+ *  provides the same link_transport_*() functions and LINK_RX_PIN, link_transport_clock_changed()
+ *  is called after clk_sys changes (see power.h):
+ *  - link_uart.h: uart0 on two wires, the default
+ *  - link_pio.h: single wire half duplex at 1 Mbit/s, PIO and DMA
+ *  - link_loopback.h: memory rings, to run the link on a host
+ */
+#if defined(KIBO_LINK_PIO)
+#include "link_pio.h"
+#elif defined(KIBO_LINK_LOOPBACK)
+#include "link_loopback.h"
+#else
+#include "link_uart.h"
+#endif
+
+#define LINK_SOF 0x7EU
+#define LINK_MAX_PAYLOAD 16U
+
+#define LINK_WINDOW 16U  // Must be a power of two, and less than half of the sequence space
+#define LINK_RETRANSMIT_US 15000U
+#define LINK_MAX_RETRIES 5U
+#define LINK_KEYFRAME_INTERVAL 250U  // ms, whole key state sent even without changes, see send_uart()
+#define LINK_FRAMES_PER_FLUSH 4U  // Frames written per flush, a go-back is spread over several link_tick()
+
+typedef enum link_types_ENUM
+{
+    // Unreliable, sent once
+    link_HELLO,  // Role negotiation, see role.h
+    link_ACK,    // Last sequence number received in order
+    link_NACK,   // Sequence number expected instead of the one received
+    link_SYNC,   // Next sequence number to expect
+    // Reliable, numbered and acknowledged
+    link_STATE_KEYFRAME,  // Whole debounced state of the sender's half, see key_state.h
+    link_STATE_DELTA,     // Runs of keys that changed since the previous state
+    link_MAX,
+} link_types;
+#define LINK_FIRST_RELIABLE link_STATE_KEYFRAME
+
+typedef struct link_frame_STRUCT
+{
+    u8 type;
+    u8 len;
+    u8 payload[LINK_MAX_PAYLOAD];  // Sequence number excluded for reliable frames
+} link_frame;
+typedef struct link_stats_STRUCT
+{
+    u32 frames_sent;
+    u32 frames_dropped;  // Sending window was full
+    u32 frames_lost;     // Given up on after LINK_MAX_RETRIES
+    u32 frames_received;
+    u32 crc_errors;
+    u32 retransmits;
+    u32 nacks_sent;
+    u32 nacks_received;
+    u32 rtt_count;
+    u32 rtt_min;  // us
+    u32 rtt_max;  // us
+    u64 rtt_total;
+} link_stats;
+
+typedef enum link_parse_states_ENUM
+{
+    parse_SOF,
+    parse_TYPE,
+    parse_LEN,
+    parse_PAYLOAD,
+    parse_CRC,
+} link_parse_states;
+typedef struct link_pending_STRUCT
+{
+    link_frame frame;
+    u32 sent_time;
+    u8 retries;
+    bool is_sent;
+} link_pending;
+
+static link_stats link_counters;
+
+static link_parse_states link_state = parse_SOF;
+static link_frame link_rx_frame;
+static u32 link_rx_index = 0;
+
+// Sending side
+static link_pending link_window[LINK_WINDOW];
+static u8 link_base = 0;      // Oldest unacknowledged sequence number
+static u8 link_next_seq = 0;  // Next sequence number to use
+static bool link_need_sync = true;
+static u32 link_sync_time = 0;
+static bool link_lost_frames = false;  // Until link_gave_up() is called
+
+// Receiving side
+static u8 link_expected = 0;
+static bool link_nack_sent = false;
+
+static u8 link_crc8(u8 crc, u8 byte)
+{
+    crc ^= byte;
+    for (u32 i = 0; i < 8; ++i)
+    {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+
+    return crc;
+}
+
+void link_init() { link_transport_init(); }
+
+// Writes one frame as is, returns false if the transport has no room for it
+static bool link_write(u8 type, const u8* payload, u32 len)
+{
+    if (len > LINK_MAX_PAYLOAD || !link_transport_writable(len + 4))
+    {
+        return false;
+    }
+
+    u8 frame[LINK_MAX_PAYLOAD + 4] = {LINK_SOF, type, len};
+    memcpy(&frame[3], payload, len);
+
+    u8 crc = 0;
+    for (u32 i = 1; i < len + 3; ++i)
+    {
+        crc = link_crc8(crc, frame[i]);
+    }
+    frame[len + 3] = crc;
+
+    link_transport_write(frame, len + 4);
+    ++link_counters.frames_sent;
+    return true;
+}
+
+// Sends an unreliable frame, it is simply lost if the transport is full
+bool link_send(link_types type, const u8* payload, u32 len) { return link_write(type, payload, len); }
+
+static link_pending* link_pending_at(u8 seq) { return &link_window[seq & (LINK_WINDOW - 1)]; }
+
+static bool link_transmit(u8 seq)
+{
+    link_pending* pending = link_pending_at(seq);
+
+    u8 payload[LINK_MAX_PAYLOAD];
+    payload[0] = seq;
+    memcpy(&payload[1], pending->frame.payload, pending->frame.len);
+    if (!link_write(pending->frame.type, payload, pending->frame.len + 1))
+    {
+        return false;
+    }
+
+    pending->sent_time = time_us_32();
+    pending->is_sent = true;
+    return true;
+}
+
+// Sends whatever is waiting in the window, a few frames at a time
+static void link_flush()
+{
+    u32 sent = 0;
+    for (u8 seq = link_base; seq != link_next_seq && sent < LINK_FRAMES_PER_FLUSH; ++seq)
+    {
+        if (link_pending_at(seq)->is_sent)
+        {
+            continue;
+        }
+        if (!link_transmit(seq))
+        {
+            return;
+        }
+        ++sent;
+    }
+}
+
+// Queues everything from the oldest unacknowledged frame to be sent again
+static void link_go_back()
+{
+    for (u8 seq = link_base; seq != link_next_seq; ++seq)
+    {
+        link_pending* pending = link_pending_at(seq);
+        if (pending->is_sent)
+        {
+            pending->is_sent = false;
+            ++pending->retries;
+            ++link_counters.retransmits;
+        }
+    }
+
+    link_flush();
+}
+
+// Sends a reliable frame, returns false only if the sending window is full
+bool link_send_reliable(link_types type, const u8* payload, u32 len)
+{
+    if ((u8)(link_next_seq - link_base) == LINK_WINDOW || len > LINK_MAX_PAYLOAD - 1)
+    {
+        ++link_counters.frames_dropped;
+        return false;
+    }
+
+    link_pending* pending = link_pending_at(link_next_seq++);
+    pending->frame.type = type;
+    pending->frame.len = len;
+    memcpy(pending->frame.payload, payload, len);
+    pending->retries = 0;
+    pending->is_sent = false;
+
+    link_flush();
+    return true;
+}
+
+static void link_on_ack(u8 seq)
+{
+    // Acknowledges the frame right before the window, i.e. a SYNC
+    if ((u8)(seq + 1) == link_base)
+    {
+        link_need_sync = false;
+        return;
+    }
+
+    // Ignore acknowledgements of frames that are not in flight
+    if ((u8)(seq - link_base) >= (u8)(link_next_seq - link_base))
+    {
+        return;
+    }
+
+    // Karn's algorithm: a retransmitted frame doesn't give a meaningful round trip
+    const link_pending* pending = link_pending_at(seq);
+    if (pending->retries == 0 && pending->is_sent)
+    {
+        const u32 rtt = time_us_32() - pending->sent_time;
+        if (link_counters.rtt_count == 0 || rtt < link_counters.rtt_min)
+        {
+            link_counters.rtt_min = rtt;
+        }
+        if (rtt > link_counters.rtt_max)
+        {
+            link_counters.rtt_max = rtt;
+        }
+        ++link_counters.rtt_count;
+        link_counters.rtt_total += rtt;
+    }
+
+    link_base = seq + 1;
+    link_need_sync = false;
+}
+
+static void link_on_nack(u8 seq)
+{
+    ++link_counters.nacks_received;
+
+    // The receiver expects a frame that was given up on, it needs to be resynchronized
+    if ((u8)(seq - link_base) > (u8)(link_next_seq - link_base))
+    {
+        link_need_sync = true;
+        link_lost_frames = true;
+        link_sync_time = time_us_32() - LINK_RETRANSMIT_US;
+        return;
+    }
+
+    // Everything before the expected frame arrived
+    if (seq != link_base)
+    {
+        link_on_ack(seq - 1);
+    }
+    link_go_back();
+}
+
+static void link_on_reliable(u8 seq)
+{
+    if (seq == link_expected)
+    {
+        link_write(link_ACK, &seq, 1);
+        ++link_expected;
+        link_nack_sent = false;
+        return;
+    }
+
+    // Duplicate of something already delivered, its ACK was probably lost
+    if ((u8)(link_expected - seq) <= LINK_WINDOW)
+    {
+        const u8 last = link_expected - 1;
+        link_write(link_ACK, &last, 1);
+        return;
+    }
+
+    // Gap, ask once for the missing frame and let the timeout handle the rest
+    if (!link_nack_sent)
+    {
+        link_write(link_NACK, &link_expected, 1);
+        link_nack_sent = true;
+        ++link_counters.nacks_sent;
+    }
+}
+
+// Returns true when an application frame is delivered, call until it returns false
+bool link_receive(link_frame* frame)
+{
+    static u8 crc = 0;
+
+    while (link_transport_readable())
+    {
+        const u8 byte = link_transport_getc();
+
+        switch (link_state)
+        {
+        case parse_SOF:
+            if (byte == LINK_SOF)
+            {
+                crc = 0;
+                link_state = parse_TYPE;
+            }
+            break;
+
+        case parse_TYPE:
+            link_rx_frame.type = byte;
+            crc = link_crc8(crc, byte);
+            link_state = parse_LEN;
+            break;
+
+        case parse_LEN:
+            link_rx_frame.len = byte;
+            link_rx_index = 0;
+            crc = link_crc8(crc, byte);
+            link_state = byte > LINK_MAX_PAYLOAD ? parse_SOF : (byte == 0 ? parse_CRC : parse_PAYLOAD);
+            break;
+
+        case parse_PAYLOAD:
+            link_rx_frame.payload[link_rx_index++] = byte;
+            crc = link_crc8(crc, byte);
+            if (link_rx_index == link_rx_frame.len)
+            {
+                link_state = parse_CRC;
+            }
+            break;
+
+        case parse_CRC:
+            link_state = parse_SOF;
+            if (byte != crc)
+            {
+                ++link_counters.crc_errors;
+                break;
+            }
+            ++link_counters.frames_received;
+
+            const u8 type = link_rx_frame.type;
+            const u8 seq = link_rx_frame.payload[0];
+            if (type != link_HELLO && link_rx_frame.len < 1)
+            {
+                break;
+            }
+
+            switch (type)
+            {
+            case link_HELLO: *frame = link_rx_frame; return true;
+            case link_ACK: link_on_ack(seq); break;
+            case link_NACK: link_on_nack(seq); break;
+            case link_SYNC:
+                link_expected = seq;
+                link_nack_sent = false;
+                const u8 last = seq - 1;
+                link_write(link_ACK, &last, 1);
+                break;
+            default:
+            {
+                // Unknown types are still acknowledged, so the sender doesn't retry them forever
+                const bool in_order = seq == link_expected;
+                link_on_reliable(seq);
+                if (!in_order || type >= link_MAX)
+                {
+                    break;
+                }
+
+                frame->type = type;
+                frame->len = link_rx_frame.len - 1;
+                memcpy(frame->payload, &link_rx_frame.payload[1], frame->len);
+                return true;
+            }
+            }
+            break;
+        }
+    }
+
+    return false;
+}
+
+// Called once per main loop iteration, handles timeouts
+void link_tick()
+{
+    const u32 now = time_us_32();
+    link_transport_tick();
+
+    // Frames in flight are sent again right behind the SYNC
+    if (link_need_sync && now - link_sync_time >= LINK_RETRANSMIT_US)
+    {
+        link_write(link_SYNC, &link_base, 1);
+        link_sync_time = now;
+        link_go_back();
+    }
+
+    if (link_base != link_next_seq)
+    {
+        const link_pending* oldest = link_pending_at(link_base);
+        if (oldest->is_sent && now - oldest->sent_time >= LINK_RETRANSMIT_US)
+        {
+            if (oldest->retries >= LINK_MAX_RETRIES)
+            {
+                // Order can't be kept anymore, drop everything in flight and resynchronize
+                link_counters.frames_lost += (u8)(link_next_seq - link_base);
+                link_base = link_next_seq;
+                link_need_sync = true;
+                link_lost_frames = true;
+                link_sync_time = now - LINK_RETRANSMIT_US;
+            }
+            else
+            {
+                link_go_back();
+            }
+        }
+    }
+
+    link_flush();
+}
+
+// True once after reliable frames were given up on
+bool link_gave_up()
+{
+    const bool lost = link_lost_frames;
+    link_lost_frames = false;
+    return lost;
+}
+
+u32 link_rtt_avg() { return link_counters.rtt_count == 0 ? 0 : link_counters.rtt_total / link_counters.rtt_count; }
+
+#endif  // LINK_H
@@ -0,0 +1,120 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef LINK_LOOPBACK_H
+#define LINK_LOOPBACK_H
+
+#include "types.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Simulated transport of the link (see link.h), for running it on a host without the other half.
+ *  What the link writes goes to loopback_tx, what it reads comes from loopback_rx: a test plays the
+ *  other half with loopback_take() and loopback_put().
+ *  Both rings drop what doesn't fit, like a line nobody listens to.
+ *  Defining LINK_LOOPBACK_ECHO sends every byte written straight back, the link then talks to itself.
+ */
+
+#define LINK_RX_PIN 1  // Not used, scan_governor.h still arms it
+#define LOOPBACK_SIZE 256U  // Must be a power of two
+
+typedef struct loopback_ring_STRUCT
+{
+    u8 bytes[LOOPBACK_SIZE];
+    u32 head;
+    u32 tail;
+    u32 dropped;
+} loopback_ring;
+
+static loopback_ring loopback_tx;
+static loopback_ring loopback_rx;
+
+static void loopback_push(loopback_ring* ring, u8 byte)
+{
+    if (ring->head - ring->tail == LOOPBACK_SIZE)
+    {
+        ++ring->dropped;
+        return;
+    }
+
+    ring->bytes[ring->head++ & (LOOPBACK_SIZE - 1)] = byte;
+}
+
+// Bytes for the link to read, returns how many fit
+u32 loopback_put(const u8* data, u32 len)
+{
+    u32 n = 0;
+    while (n < len && loopback_rx.head - loopback_rx.tail < LOOPBACK_SIZE)
+    {
+        loopback_push(&loopback_rx, data[n++]);
+    }
+
+    return n;
+}
+
+// Bytes the link wrote, returns how many were taken
+u32 loopback_take(u8* data, u32 max)
+{
+    u32 n = 0;
+    while (n < max && loopback_tx.tail != loopback_tx.head)
+    {
+        data[n++] = loopback_tx.bytes[loopback_tx.tail++ & (LOOPBACK_SIZE - 1)];
+    }
+
+    return n;
+}
+
+void link_transport_init()
+{
+    memset(&loopback_tx, 0, sizeof(loopback_tx));
+    memset(&loopback_rx, 0, sizeof(loopback_rx));
+}
+
+bool link_transport_writable(u32 len) { return LOOPBACK_SIZE - (loopback_tx.head - loopback_tx.tail) >= len; }
+
+void link_transport_write(const u8* data, u32 len)
+{
+    for (u32 i = 0; i < len; ++i)
+    {
+#ifdef LINK_LOOPBACK_ECHO
+        loopback_push(&loopback_rx, data[i]);
+#else
+        loopback_push(&loopback_tx, data[i]);
+#endif
+    }
+}
+
+bool link_transport_readable() { return loopback_rx.tail != loopback_rx.head; }
+
+u8 link_transport_getc() { return loopback_rx.bytes[loopback_rx.tail++ & (LOOPBACK_SIZE - 1)]; }
+
+void link_transport_tick() {}
+
+void link_transport_clock_changed() {}
+
+#endif  // LINK_LOOPBACK_H
@@ -0,0 +1,243 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef LINK_PIO_H
+#define LINK_PIO_H
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "link_pio.pio.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Notes:
+ *  Transport of the link (see link.h) over a single wire, so a 3-pole TRRS cable is enough.
+ *  Both halves share the wire half duplex, 8N1 at LINK_BAUDRATE, one PIO state machine sending and
+ *  one receiving (see link_pio.pio). The wire is open drain and needs an external pull-up of about
+ *  1 kOhm, the internal one is far too weak for 1 Mbit/s over a cable.
+ *
+ *  Both directions go through DMA, the CPU only copies frames in and out of RAM:
+ *  - Frames are gathered in one of two buffers, and a buffer goes out as one DMA transfer.
+ *  - Received bytes land in a ring written by DMA, its write address is where the ring ends.
+ *    The transfer is re-armed when it runs out, after about 12 hours at full load.
+ *  Receiving is paused while sending, the wire would only echo our own bytes.
+ *
+ *  Sending waits for the wire to be quiet, but both halves can still start at once. A collision
+ *  garbles both frames, which fail their CRC and get sent again by the link's go-back-N.
+ */
+
+#define LINK_PIO pio0
+#define LINK_DATA_PIN 1
+#define LINK_RX_PIN LINK_DATA_PIN  // Wakes the scan governor while suspended
+#define LINK_BAUDRATE 1000000
+#define LINK_PIO_CYCLES_PER_BIT 8U
+
+#define LINK_PIO_TX_SIZE 128U
+#define LINK_PIO_RX_SIZE 1024U  // Must be a power of two, holds 10 ms at full load
+#define LINK_PIO_RX_RING_BITS 10U
+
+static u32 link_pio_tx_sm;
+static u32 link_pio_tx_offset;
+static u32 link_pio_rx_sm;
+static u32 link_pio_rx_offset;
+static int link_pio_tx_dma;
+static int link_pio_rx_dma;
+
+static u8 link_pio_tx_buffers[2][LINK_PIO_TX_SIZE];
+static u32 link_pio_tx_lens[2] = {0};
+static u32 link_pio_tx_fill = 0;  // Buffer frames are gathered in, the other one may be on the wire
+static bool link_pio_sending = false;
+
+static u8 link_pio_rx_ring[LINK_PIO_RX_SIZE] __attribute__((aligned(LINK_PIO_RX_SIZE)));
+static u32 link_pio_rx_tail = 0;
+static u32 link_pio_rx_last_head = 0;  // Where the ring ended at the previous tick
+
+static u32 link_pio_rx_head() { return (dma_channel_hw_addr(link_pio_rx_dma)->write_addr - (uintptr_t)link_pio_rx_ring) & (LINK_PIO_RX_SIZE - 1); }
+
+static void link_pio_rx_arm()
+{
+    dma_channel_config c = dma_channel_get_default_config(link_pio_rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, LINK_PIO_RX_RING_BITS);
+    channel_config_set_dreq(&c, pio_get_dreq(LINK_PIO, link_pio_rx_sm, false));
+
+    // The byte is shifted in from the left, it ends up in the top byte of the FIFO entry
+    const volatile u8* fifo = (const volatile u8*)&LINK_PIO->rxf[link_pio_rx_sm] + 3;
+    dma_channel_configure(link_pio_rx_dma, &c, &link_pio_rx_ring[link_pio_rx_head()], fifo, UINT32_MAX, true);
+}
+
+// Receiving restarts from a clean state, bytes half received when it stopped are lost anyway
+static void link_pio_rx_enable(bool is_enabled)
+{
+    if (!is_enabled)
+    {
+        pio_sm_set_enabled(LINK_PIO, link_pio_rx_sm, false);
+        return;
+    }
+
+    pio_sm_clear_fifos(LINK_PIO, link_pio_rx_sm);
+    pio_sm_restart(LINK_PIO, link_pio_rx_sm);
+    pio_sm_exec(LINK_PIO, link_pio_rx_sm, pio_encode_jmp(link_pio_rx_offset));
+    pio_sm_set_enabled(LINK_PIO, link_pio_rx_sm, true);
+}
+
+// The last stop bit is on the wire once the state machine waits for a byte that isn't coming
+static bool link_pio_tx_done()
+{
+    return !dma_channel_is_busy(link_pio_tx_dma) && pio_sm_is_tx_fifo_empty(LINK_PIO, link_pio_tx_sm) &&
+           pio_sm_get_pc(LINK_PIO, link_pio_tx_sm) == link_pio_tx_offset;
+}
+
+// Nothing arrived since the previous tick, and the receiver isn't in the middle of a byte
+static bool link_pio_wire_quiet()
+{
+    return link_pio_rx_head() == link_pio_rx_last_head && pio_sm_get_pc(LINK_PIO, link_pio_rx_sm) == link_pio_rx_offset && gpio_get(LINK_DATA_PIN);
+}
+
+static void link_pio_kick()
+{
+    if (link_pio_sending)
+    {
+        if (!link_pio_tx_done())
+        {
+            return;
+        }
+        link_pio_sending = false;
+        link_pio_rx_enable(true);
+    }
+
+    const u32 fill = link_pio_tx_fill;
+    if (link_pio_tx_lens[fill] == 0 || !link_pio_wire_quiet())
+    {
+        return;
+    }
+
+    link_pio_rx_enable(false);
+    link_pio_sending = true;
+    dma_channel_transfer_from_buffer_now(link_pio_tx_dma, link_pio_tx_buffers[fill], link_pio_tx_lens[fill]);
+
+    link_pio_tx_fill ^= 1;
+    link_pio_tx_lens[link_pio_tx_fill] = 0;
+}
+
+static float link_pio_clkdiv() { return (float)clock_get_hz(clk_sys) / (LINK_PIO_CYCLES_PER_BIT * LINK_BAUDRATE); }
+
+void link_transport_init()
+{
+    const float clkdiv = link_pio_clkdiv();
+
+    // The pin's output level stays low, the state machines only switch its direction
+    pio_gpio_init(LINK_PIO, LINK_DATA_PIN);
+    gpio_pull_up(LINK_DATA_PIN);
+
+    link_pio_tx_sm = pio_claim_unused_sm(LINK_PIO, true);
+    link_pio_tx_offset = pio_add_program(LINK_PIO, &link_pio_tx_program);
+    pio_sm_config tx = link_pio_tx_program_get_default_config(link_pio_tx_offset);
+    sm_config_set_sideset_pins(&tx, LINK_DATA_PIN);
+    sm_config_set_set_pins(&tx, LINK_DATA_PIN, 1);
+    sm_config_set_out_pins(&tx, LINK_DATA_PIN, 1);
+    sm_config_set_out_shift(&tx, true, false, 8);
+    sm_config_set_fifo_join(&tx, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&tx, clkdiv);
+    pio_sm_set_pins_with_mask(LINK_PIO, link_pio_tx_sm, 0, 1U << LINK_DATA_PIN);
+    pio_sm_set_pindirs_with_mask(LINK_PIO, link_pio_tx_sm, 0, 1U << LINK_DATA_PIN);
+    pio_sm_init(LINK_PIO, link_pio_tx_sm, link_pio_tx_offset, &tx);
+    pio_sm_set_enabled(LINK_PIO, link_pio_tx_sm, true);
+
+    link_pio_rx_sm = pio_claim_unused_sm(LINK_PIO, true);
+    link_pio_rx_offset = pio_add_program(LINK_PIO, &link_pio_rx_program);
+    pio_sm_config rx = link_pio_rx_program_get_default_config(link_pio_rx_offset);
+    sm_config_set_in_pins(&rx, LINK_DATA_PIN);
+    sm_config_set_jmp_pin(&rx, LINK_DATA_PIN);
+    sm_config_set_in_shift(&rx, true, false, 32);
+    sm_config_set_fifo_join(&rx, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv(&rx, clkdiv);
+    pio_sm_init(LINK_PIO, link_pio_rx_sm, link_pio_rx_offset, &rx);
+    pio_sm_set_enabled(LINK_PIO, link_pio_rx_sm, true);
+
+    link_pio_tx_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(link_pio_tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(LINK_PIO, link_pio_tx_sm, true));
+    dma_channel_configure(link_pio_tx_dma, &c, &LINK_PIO->txf[link_pio_tx_sm], NULL, 0, false);
+
+    link_pio_rx_dma = dma_claim_unused_channel(true);
+    dma_channel_set_write_addr(link_pio_rx_dma, link_pio_rx_ring, false);
+    link_pio_rx_arm();
+}
+
+bool link_transport_writable(u32 len) { return link_pio_tx_lens[link_pio_tx_fill] + len <= LINK_PIO_TX_SIZE; }
+
+// Bytes go out inverted, see link_pio.pio
+void link_transport_write(const u8* data, u32 len)
+{
+    u8* buffer = link_pio_tx_buffers[link_pio_tx_fill];
+    u32* buffer_len = &link_pio_tx_lens[link_pio_tx_fill];
+    for (u32 i = 0; i < len && *buffer_len < LINK_PIO_TX_SIZE; ++i)
+    {
+        buffer[(*buffer_len)++] = ~data[i];
+    }
+
+    link_pio_kick();
+}
+
+bool link_transport_readable() { return link_pio_rx_tail != link_pio_rx_head(); }
+
+u8 link_transport_getc()
+{
+    const u8 byte = link_pio_rx_ring[link_pio_rx_tail];
+    link_pio_rx_tail = (link_pio_rx_tail + 1) & (LINK_PIO_RX_SIZE - 1);
+    return byte;
+}
+
+// Called once per main loop iteration
+void link_transport_tick()
+{
+    if (!dma_channel_is_busy(link_pio_rx_dma))
+    {
+        link_pio_rx_arm();
+    }
+
+    link_pio_kick();
+    link_pio_rx_last_head = link_pio_rx_head();
+}
+
+// The state machines run from clk_sys, a byte in flight when it changes is garbled and sent again
+void link_transport_clock_changed()
+{
+    pio_sm_set_clkdiv(LINK_PIO, link_pio_tx_sm, link_pio_clkdiv());
+    pio_sm_set_clkdiv(LINK_PIO, link_pio_rx_sm, link_pio_clkdiv());
+}
+
+#endif  // LINK_PIO_H
@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef LINK_UART_H
+#define LINK_UART_H
+
+#include "hardware/uart.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  Default transport of the link (see link.h): uart0, full duplex over two wires.
+ *  Frames are queued in link_uart_tx and moved to the 32 byte TX FIFO as it empties, by every
+ *  write and link_transport_tick(): a frame takes about 1.7 ms to go out at LINK_BAUDRATE, waiting
+ *  on the FIFO would stall the loop that long. A frame is only queued if it fits whole.
+ */
+
+#define LINK_UART uart0
+#define LINK_BAUDRATE 115200
+#define LINK_TX_PIN 0
+#define LINK_RX_PIN 1  // Wakes the scan governor while suspended
+#define LINK_UART_TX_SIZE 128U  // Must be a power of two
+
+static u8 link_uart_tx[LINK_UART_TX_SIZE];
+static u32 link_uart_tx_head = 0;
+static u32 link_uart_tx_tail = 0;
+
+// Moves queued bytes to the TX FIFO until it is full, never waits
+static void link_uart_drain()
+{
+    while (link_uart_tx_tail != link_uart_tx_head && uart_is_writable(LINK_UART))
+    {
+        uart_putc_raw(LINK_UART, (char)link_uart_tx[link_uart_tx_tail++ & (LINK_UART_TX_SIZE - 1)]);
+    }
+}
+
+void link_transport_init()
+{
+    uart_init(LINK_UART, LINK_BAUDRATE);
+
+    // Set the TX and RX pins by using the function select on the GPIO
+    // Set datasheet for more information on function select
+    gpio_set_function(LINK_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(LINK_RX_PIN, GPIO_FUNC_UART);
+}
+
+bool link_transport_writable(u32 len) { return LINK_UART_TX_SIZE - (link_uart_tx_head - link_uart_tx_tail) >= len; }
+
+void link_transport_write(const u8* data, u32 len)
+{
+    for (u32 i = 0; i < len; ++i)
+    {
+        link_uart_tx[link_uart_tx_head++ & (LINK_UART_TX_SIZE - 1)] = data[i];
+    }
+
+    link_uart_drain();
+}
+
+bool link_transport_readable() { return uart_is_readable(LINK_UART); }
+
+u8 link_transport_getc() { return uart_getc(LINK_UART); }
+
+void link_transport_tick() { link_uart_drain(); }
+
+// The UART is clocked from clk_peri, which follows clk_sys
+void link_transport_clock_changed() { uart_set_baudrate(LINK_UART, LINK_BAUDRATE); }
+
+#endif  // LINK_UART_H
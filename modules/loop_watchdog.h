@@ -0,0 +1,129 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef LOOP_WATCHDOG_H
+#define LOOP_WATCHDOG_H
+
+#include "hardware/structs/vreg_and_chip_reset.h"
+#include "hardware/watchdog.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  The hardware watchdog resets the chip if the main loop stops coming around for LOOP_WATCHDOG_TIMEOUT_MS,
+ *  which has to stay above the slowest scan period (governor_SUSPENDED, see scan_governor.h).
+ *  It is paused while a debugger halts the cores.
+ *
+ *  Watchdog scratch registers 0-3 survive every reset but power loss and are read after a hang,
+ *  with the console's watchdog command or over SWD (0x4005800C onwards):
+ *  0: LOOP_WATCHDOG_MAGIC, the others are only meaningful with it
+ *  1: where the main loop is, a profiler stage, stage_FRAME between stages (see profiler.h)
+ *  2: number of hangs since power up
+ *  3: why the chip last reset, a reset_causes
+ *  The pico SDK keeps 4-7 for itself.
+ */
+
+#define LOOP_WATCHDOG_TIMEOUT_MS 2000U
+#define LOOP_WATCHDOG_MAGIC 0x6B69626FU  // "kibo"
+
+typedef enum loop_watchdog_scratches_ENUM
+{
+    scratch_MAGIC,
+    scratch_WHERE,
+    scratch_HANGS,
+    scratch_RESET_CAUSE,
+    scratch_MAX,
+} loop_watchdog_scratches;
+
+typedef enum reset_causes_ENUM
+{
+    reset_POWER_ON,  // Or brown out
+    reset_RUN_PIN,   // RUN pulled low, e.g. a reset button or a debugger
+    reset_REBOOT,    // watchdog_reboot(), e.g. from the debugger or the console
+    reset_HANG,      // The main loop stopped feeding the watchdog
+    reset_MAX,
+} reset_causes;
+
+static const char* const reset_cause_names[reset_MAX] = {
+    [reset_POWER_ON] = "power on",
+    [reset_RUN_PIN] = "run pin",
+    [reset_REBOOT] = "reboot",
+    [reset_HANG] = "hang",
+};
+
+static reset_causes reset_cause = reset_POWER_ON;
+static u32 hang_where = 0;  // Where the main loop was when it last hung, if it ever did
+
+static reset_causes loop_watchdog_read_cause()
+{
+    if (watchdog_enable_caused_reboot())
+    {
+        return reset_HANG;
+    }
+    if (watchdog_caused_reboot())
+    {
+        return reset_REBOOT;
+    }
+    if (vreg_and_chip_reset_hw->chip_reset & VREG_AND_CHIP_RESET_CHIP_RESET_HAD_RUN_BITS)
+    {
+        return reset_RUN_PIN;
+    }
+
+    return reset_POWER_ON;
+}
+
+// Called first thing at boot, before anything can overwrite the scratch registers
+void loop_watchdog_init()
+{
+    reset_cause = loop_watchdog_read_cause();
+
+    if (watchdog_hw->scratch[scratch_MAGIC] != LOOP_WATCHDOG_MAGIC || reset_cause == reset_POWER_ON)
+    {
+        watchdog_hw->scratch[scratch_MAGIC] = LOOP_WATCHDOG_MAGIC;
+        watchdog_hw->scratch[scratch_HANGS] = 0;
+    }
+    else if (reset_cause == reset_HANG)
+    {
+        hang_where = watchdog_hw->scratch[scratch_WHERE];
+        ++watchdog_hw->scratch[scratch_HANGS];
+    }
+
+    watchdog_hw->scratch[scratch_RESET_CAUSE] = reset_cause;
+    watchdog_hw->scratch[scratch_WHERE] = 0;
+}
+
+// Called once init is done, the main loop feeds it from then on
+void loop_watchdog_start() { watchdog_enable(LOOP_WATCHDOG_TIMEOUT_MS, true); }
+
+void __not_in_flash_func(loop_watchdog_feed)() { watchdog_update(); }
+
+void __not_in_flash_func(loop_watchdog_mark)(u32 where) { watchdog_hw->scratch[scratch_WHERE] = where; }
+
+u32 loop_watchdog_hangs() { return watchdog_hw->scratch[scratch_HANGS]; }
+
+#endif  // LOOP_WATCHDOG_H
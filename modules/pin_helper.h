@@ -63,6 +63,6 @@ void gp_on(u32 gpio) { gpio_put(gpio, true); }
 
 void gp_off(u32 gpio) { gpio_put(gpio, false); }
 
-bool gp_get(u32 gpio) { return gpio_get(gpio); }
+bool __not_in_flash_func(gp_get)(u32 gpio) { return gpio_get(gpio); }
 
 #endif  // PIN_HELPER_H
\ No newline at end of file
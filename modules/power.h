@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include "hardware/clocks.h"
+#include "link.h"
+#include "pico/stdlib.h"
+#include "role.h"
+#include "scan_governor.h"
+#include "tusb.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  While the host has the bus suspended, both halves sleep: the master because of the suspend,
+ *  the slave because the master asks it to in its hellos (see role.h).
+ *  Asleep, the main loop only runs on a key edge, a link byte, a USB interrupt or the slow keepalive
+ *  (see scan_governor.h), and clk_sys runs at POWER_SLEEP_KHZ. USB has its own PLL, it doesn't mind.
+ *
+ *  A key going down on either half while the host is suspended is the only thing that wakes it up,
+ *  if it allowed remote wakeup. Its tap waits for the resume (see hid_report.h), the time from the
+ *  key event to the host getting its report is the wake latency.
+ */
+
+#define POWER_SLEEP_KHZ 48000U
+
+static bool power_host_suspended = false;
+static bool power_remote_wakeup = false;  // Allowed by the host
+static bool power_asleep = false;
+static u32 power_awake_khz = 0;
+
+static bool power_waking = false;
+static u32 power_wake_start = 0;       // us, time of the key event that woke the host
+static u32 power_wake_latency = 0;     // us, of the last wake
+static u32 power_wake_latency_max = 0;  // us
+static u32 power_wakes = 0;
+
+void power_init() { power_awake_khz = clock_get_hz(clk_sys) / 1000; }
+
+static void power_set_clock(u32 khz)
+{
+    set_sys_clock_khz(khz, false);
+    link_transport_clock_changed();
+}
+
+// Called from the suspend, resume and unmount callbacks
+void power_host_suspend(bool is_suspended, bool remote_wakeup)
+{
+    power_host_suspended = is_suspended;
+    power_remote_wakeup = remote_wakeup;
+}
+
+// Called once per main loop iteration, after role_tick()
+void power_update()
+{
+    const bool wants_sleep = is_master ? power_host_suspended : peer_asks_sleep;
+    if (wants_sleep == power_asleep)
+    {
+        return;
+    }
+
+    power_asleep = wants_sleep;
+    role_asleep = wants_sleep;
+    scan_governor_suspend(wants_sleep);
+
+    // Waking, the clock comes back first so the loop is at full speed for the key that woke it
+    power_set_clock(wants_sleep ? POWER_SLEEP_KHZ : power_awake_khz);
+    role_update();
+}
+
+// Called by the master for every key going down
+void __not_in_flash_func(power_key_down)()
+{
+    if (!power_host_suspended || !power_remote_wakeup || power_waking)
+    {
+        return;
+    }
+
+    power_waking = true;
+    power_wake_start = time_us_32();
+    tud_remote_wakeup();
+}
+
+// Called when the host got a report
+void power_report_sent()
+{
+    if (!power_waking || power_host_suspended)
+    {
+        return;
+    }
+
+    power_waking = false;
+    power_wake_latency = time_us_32() - power_wake_start;
+    if (power_wake_latency > power_wake_latency_max)
+    {
+        power_wake_latency_max = power_wake_latency;
+    }
+    ++power_wakes;
+}
+
+#endif  // POWER_H
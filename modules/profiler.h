@@ -0,0 +1,184 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "loop_watchdog.h"
+#include "pico/stdlib.h"
+#include "types.h"
+#include "usb_descriptors.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Durations are measured in microseconds with the hardware timer (time_us_32()).
+ *  stage_FRAME is the time between two iterations of the main loop, i.e. the real scan period.
+ *  Histogram bucket n counts durations in [2^(n-1), 2^n) us, the last bucket also holds everything above.
+ *  The stage being run is also left in a watchdog scratch register, to tell where a hang happened (see loop_watchdog.h).
+ */
+
+#define PROFILER_BUCKETS 16U
+
+typedef enum profiler_stages_ENUM
+{
+    stage_FRAME,          // Full main loop iteration, sleep included
+    stage_TUD_TASK,       // tud_task()
+    stage_DELTA_TIME,     // delta_time_update()
+    stage_PARSE_INPUTS,   // parse_inputs()
+    stage_HANDLE_EVENTS,  // handle_events()
+    stage_HANDLE_UART,    // handle_uart()
+    stage_CONSOLE,        // console_update(), only with KIBO_CONSOLE
+    stage_MAX,
+} profiler_stages;
+typedef struct profiler_stats_STRUCT
+{
+    u32 count;
+    u32 min;
+    u32 max;
+    u64 total;
+    u16 histogram[PROFILER_BUCKETS];
+} profiler_stats;
+
+static const char* const profiler_stage_names[stage_MAX] = {
+    [stage_FRAME] = "frame",
+    [stage_TUD_TASK] = "tud_task",
+    [stage_DELTA_TIME] = "delta_time",
+    [stage_PARSE_INPUTS] = "parse_inputs",
+    [stage_HANDLE_EVENTS] = "handle_events",
+    [stage_HANDLE_UART] = "handle_uart",
+    [stage_CONSOLE] = "console",
+};
+
+static profiler_stats profiler_table[stage_MAX];
+static u32 profiler_start[stage_MAX];
+static u32 profiler_cursor = 0;
+
+static void profiler_record(profiler_stages stage, u32 duration)
+{
+    profiler_stats* stats = &profiler_table[stage];
+
+    if (stats->count == 0 || duration < stats->min)
+    {
+        stats->min = duration;
+    }
+    if (duration > stats->max)
+    {
+        stats->max = duration;
+    }
+    ++stats->count;
+    stats->total += duration;
+
+    u32 bucket = duration == 0 ? 0 : 32 - __builtin_clz(duration);
+    if (bucket >= PROFILER_BUCKETS)
+    {
+        bucket = PROFILER_BUCKETS - 1;
+    }
+
+    // Saturate instead of wrapping so long runs keep their shape
+    if (stats->histogram[bucket] != 0xFFFF)
+    {
+        ++stats->histogram[bucket];
+    }
+}
+
+void profiler_reset() { memset(profiler_table, 0, sizeof(profiler_table)); }
+
+void profiler_begin(profiler_stages stage)
+{
+    loop_watchdog_mark(stage);
+    profiler_start[stage] = time_us_32();
+}
+
+void profiler_end(profiler_stages stage)
+{
+    profiler_record(stage, time_us_32() - profiler_start[stage]);
+    loop_watchdog_mark(stage_FRAME);
+}
+
+// Called once at the top of every main loop iteration
+void profiler_frame()
+{
+    static bool has_started = false;
+
+    const u32 now = time_us_32();
+    if (has_started)
+    {
+        profiler_record(stage_FRAME, now - profiler_start[stage_FRAME]);
+    }
+
+    profiler_start[stage_FRAME] = now;
+    has_started = true;
+}
+
+u32 profiler_avg(profiler_stages stage)
+{
+    const profiler_stats* stats = &profiler_table[stage];
+    return stats->count == 0 ? 0 : stats->total / stats->count;
+}
+
+static void profiler_write_u32(u8* buffer, u32 value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+    buffer[3] = value >> 24;
+}
+
+/*
+ *  Report layout (little endian), one stage per read, cycling through all stages:
+ *  [0] stage, [1] stage_MAX, then u32 count, min, max, avg and u16 histogram[PROFILER_BUCKETS]
+ */
+u16 profiler_read_report(u8* buffer, u16 reqlen)
+{
+    if (reqlen < STATS_REPORT_SIZE)
+    {
+        return 0;
+    }
+
+    memset(buffer, 0, STATS_REPORT_SIZE);
+
+    const profiler_stages stage = profiler_cursor;
+    const profiler_stats* stats = &profiler_table[stage];
+    profiler_cursor = (profiler_cursor + 1) % stage_MAX;
+
+    buffer[0] = stage;
+    buffer[1] = stage_MAX;
+    profiler_write_u32(&buffer[2], stats->count);
+    profiler_write_u32(&buffer[6], stats->min);
+    profiler_write_u32(&buffer[10], stats->max);
+    profiler_write_u32(&buffer[14], profiler_avg(stage));
+    for (u32 i = 0; i < PROFILER_BUCKETS; ++i)
+    {
+        buffer[18 + i * 2] = stats->histogram[i];
+        buffer[19 + i * 2] = stats->histogram[i] >> 8;
+    }
+
+    return STATS_REPORT_SIZE;
+}
+
+#endif  // PROFILER_H
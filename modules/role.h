@@ -0,0 +1,219 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ROLE_H
+#define ROLE_H
+
+#include "boot_time.h"
+#include "bsp/board_api.h"
+#include "debug_led.h"
+#include "input_parse.h"
+#include "key_map.h"
+#include "link.h"
+#include "pico/stdlib.h"
+#include "pin_helper.h"
+#include "timer.h"
+#include "tusb.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  Both halves run the same firmware, the master is the half that has a host.
+ *  Each half periodically tells the other if it has a host and which side it is,
+ *  and tells it right away when its USB gets (un)mounted.
+ *  If both or neither have a host, the half powered by its own USB cable (VBUS) is the master,
+ *  so the half being enumerated already handles keys and they go out as soon as it is mounted.
+ *  If that doesn't tell them apart either, the left half is the master.
+ *  Handedness comes from a strap pin: tied to ground on the left half, left floating on the right one.
+ *  Building with IS_LEFT forces the left side, for boards without the strap.
+ *  While the host is suspended the master asks the slave to sleep too (see power.h), hellos then
+ *  become a slow keepalive so neither half has to wake up often.
+ *  The master also says if it wants eager debounce, the slave debounces its keys and has to follow.
+ *
+ *  Hellos are also the link's heartbeat. Without one for ROLE_PEER_TIMEOUT the other half is gone
+ *  (cable pulled, or it hung and its watchdog is resetting it), so the master releases its keys
+ *  rather than leaving them held. When it comes back its first state frame is a keyframe.
+ */
+
+#define HANDEDNESS_PIN 28
+#define ROLE_HELLO_INTERVAL 50   // ms
+#define ROLE_PEER_TIMEOUT 250    // ms
+#define ROLE_SLEEP_HELLO_INTERVAL 1000  // ms
+#define ROLE_SLEEP_PEER_TIMEOUT 3500    // ms
+#ifndef PICO_VBUS_PIN
+#define PICO_VBUS_PIN 24  // Pico's, boards that sense VBUS elsewhere define it in their board header
+#endif
+#define ROLE_VBUS_PIN PICO_VBUS_PIN  // High while the half's own USB cable powers it
+
+#define ROLE_HAS_HOST 0x01U
+#define ROLE_IS_LEFT 0x02U
+#define ROLE_EAGER 0x04U
+#define ROLE_HAS_VBUS 0x08U
+#define ROLE_SLEEP 0x10U
+
+static bool is_master = false;
+static bool is_left = false;
+
+static bool peer_seen = false;
+static bool peer_has_host = false;
+static bool peer_is_left = false;
+static bool peer_has_vbus = false;
+static bool role_vbus = false;
+static bool role_asleep = false;  // Set by power.h
+static bool peer_asks_sleep = false;
+static u32 peer_last_hello = 0;
+static bool peer_needs_keyframe = false;  // Cleared by whoever sends the key state
+static u32 peer_losses = 0;
+
+static struct cooldown_timer role_hello_cdt;
+
+sides local_side() { return is_left ? side_LEFT : side_RIGHT; }
+
+sides remote_side() { return is_left ? side_RIGHT : side_LEFT; }
+
+static void role_send_hello()
+{
+    const u8 flags = (tud_mounted() ? ROLE_HAS_HOST : 0) | (is_left ? ROLE_IS_LEFT : 0) | (is_master && debounce_eager ? ROLE_EAGER : 0) |
+                     (role_vbus ? ROLE_HAS_VBUS : 0) | (is_master && role_asleep ? ROLE_SLEEP : 0);
+    link_send(link_HELLO, &flags, 1);
+}
+
+// A host beats VBUS alone, which beats nothing
+static u32 role_rank(bool has_host, bool has_vbus) { return has_host ? 2 : (has_vbus ? 1 : 0); }
+
+// Recomputes the role and announces it, called whenever something changed
+void role_update()
+{
+    const bool was_master = is_master;
+    role_vbus = gp_get(ROLE_VBUS_PIN);
+    const u32 rank = role_rank(tud_mounted(), role_vbus);
+    if (!peer_seen)
+    {
+        is_master = rank > 0;
+    }
+    else if (rank != role_rank(peer_has_host, peer_has_vbus))
+    {
+        is_master = rank > role_rank(peer_has_host, peer_has_vbus);
+    }
+    else
+    {
+        is_master = is_left;
+    }
+
+    // A new master starts from what the other half sends next
+    if (was_master && !is_master)
+    {
+        reset_remote_state(remote_side());
+    }
+
+    // Two halves of the same side can't be told apart, blink to show the wiring is wrong
+    debug_led_set_interval(peer_seen && peer_is_left == is_left ? 250 : 0);
+
+    role_send_hello();
+}
+
+void role_init()
+{
+    gp_in(ROLE_VBUS_PIN);
+    gp_in(HANDEDNESS_PIN);
+    gpio_pull_up(HANDEDNESS_PIN);
+    sleep_us(10);
+
+#ifdef KIBO_LEFT
+    is_left = true;
+#else
+    is_left = !gp_get(HANDEDNESS_PIN);
+#endif
+
+    role_hello_cdt.cooldown = ROLE_HELLO_INTERVAL;
+    role_hello_cdt.last_update = board_millis();
+    role_update();
+}
+
+void role_receive_hello(const link_frame* frame)
+{
+    if (frame->len < 1)
+    {
+        return;
+    }
+
+    const bool has_host = frame->payload[0] & ROLE_HAS_HOST;
+    const bool left = frame->payload[0] & ROLE_IS_LEFT;
+    const bool has_vbus = frame->payload[0] & ROLE_HAS_VBUS;
+    peer_needs_keyframe |= !peer_seen;
+
+    const bool changed = !peer_seen || has_host != peer_has_host || left != peer_is_left || has_vbus != peer_has_vbus;
+
+    peer_seen = true;
+    peer_has_host = has_host;
+    peer_is_left = left;
+    peer_has_vbus = has_vbus;
+    peer_asks_sleep = frame->payload[0] & ROLE_SLEEP;
+    peer_last_hello = board_millis();
+    boot_stamp(boot_PEER);
+
+    if (changed)
+    {
+        role_update();
+    }
+
+    if (!is_master)
+    {
+        set_eager_debounce(frame->payload[0] & ROLE_EAGER, local_side());
+    }
+}
+
+// Called once per main loop iteration
+void role_tick()
+{
+    if (peer_seen && board_millis() - peer_last_hello > (role_asleep ? ROLE_SLEEP_PEER_TIMEOUT : ROLE_PEER_TIMEOUT))
+    {
+        // Its releases will never come, send them now
+        if (is_master)
+        {
+            const key_bits released = {0};
+            update_remote_state(remote_side(), &released);
+        }
+
+        ++peer_losses;
+        peer_seen = false;
+        peer_asks_sleep = false;
+        role_update();
+    }
+    else if (gp_get(ROLE_VBUS_PIN) != role_vbus)
+    {
+        role_update();
+    }
+
+    role_hello_cdt.cooldown = role_asleep ? ROLE_SLEEP_HELLO_INTERVAL : ROLE_HELLO_INTERVAL;
+    if (cooldown_timer_update(&role_hello_cdt))
+    {
+        role_send_hello();
+    }
+}
+
+#endif  // ROLE_H
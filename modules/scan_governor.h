@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SCAN_GOVERNOR_H
+#define SCAN_GOVERNOR_H
+
+#include "bsp/board.h"
+#include "link.h"
+#include "pico/stdlib.h"
+#include "types.h"
+
+#include <stdbool.h>
+
+/*
+ *  Notes:
+ *  Paces the main loop: full rate while a key is held or debouncing, a slower rate once the
+ *  keyboard has been idle for a while, and only edges or a long timeout while the keyboard sleeps (see power.h).
+ *  A key held or debouncing while asleep is scanned at full rate, so the key that wakes the host isn't slowed down.
+ *  Key pins raise an interrupt on every edge, so a key press ends the wait right away whatever the rate.
+ *  The link's RX pin only wakes the loop while suspended, at full link load it would interrupt all the time.
+ *  Waiting is done with WFE, the core sleeps until the deadline, an edge or any other interrupt (e.g. USB).
+ */
+
+typedef enum governor_states_ENUM
+{
+    governor_ACTIVE,     // A key is held or debouncing
+    governor_IDLE,       // Nothing happened for governor_idle_after ms
+    governor_SUSPENDED,  // Asleep, wait for edges
+    governor_MAX,
+} governor_states;
+
+static const char* const governor_state_names[governor_MAX] = {
+    [governor_ACTIVE] = "active",
+    [governor_IDLE] = "idle",
+    [governor_SUSPENDED] = "suspended",
+};
+
+// Frame periods, in us
+static u32 governor_periods[governor_MAX] = {
+    [governor_ACTIVE] = 125,  // 8 kHz
+    [governor_IDLE] = 1000,
+    [governor_SUSPENDED] = 1000000,  // Only for the link's sleep keepalive, see role.h
+};
+static u32 governor_idle_after = 200;  // ms
+
+static governor_states governor_state = governor_ACTIVE;
+static u32 governor_frames[governor_MAX] = {0};
+static u32 governor_last_activity = 0;
+static absolute_time_t governor_frame_start = 0;
+static bool governor_suspended = false;
+static volatile bool governor_woken = false;
+
+static void governor_edge_cb(uint gpio, uint32_t event_mask) { governor_woken = true; }
+
+// Wakes the loop on every edge of this pin
+void scan_governor_watch(u32 gpio) { gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, governor_edge_cb); }
+
+// For scans that make edges on watched pins themselves, e.g. matrix strobing
+void scan_governor_ignore_edges() { governor_woken = false; }
+
+void scan_governor_suspend(bool is_suspended)
+{
+    governor_suspended = is_suspended;
+    gpio_set_irq_enabled(LINK_RX_PIN, GPIO_IRQ_EDGE_FALL, is_suspended);
+}
+
+// Called once per frame, busy tells whether any key is held or debouncing
+void scan_governor_update(bool busy)
+{
+    if (busy || governor_woken)
+    {
+        governor_last_activity = board_millis();
+    }
+
+    if (governor_suspended && !busy)
+    {
+        governor_state = governor_SUSPENDED;
+    }
+    else if (board_millis() - governor_last_activity < governor_idle_after)
+    {
+        governor_state = governor_ACTIVE;
+    }
+    else
+    {
+        governor_state = governor_IDLE;
+    }
+
+    ++governor_frames[governor_state];
+}
+
+// True once nothing happened for at least ms, e.g. to do something that stalls the loop
+bool scan_governor_idle_for(u32 ms) { return governor_state != governor_ACTIVE && board_millis() - governor_last_activity >= ms; }
+
+// Waits until the next frame is due, from the start of the current one so frames keep their rate
+void scan_governor_wait()
+{
+    const absolute_time_t deadline = delayed_by_us(governor_frame_start, governor_periods[governor_state]);
+
+    while (!governor_woken && !time_reached(deadline))
+    {
+        best_effort_wfe_or_timeout(deadline);
+    }
+
+    governor_woken = false;
+    governor_frame_start = get_absolute_time();
+}
+
+void scan_governor_reset_stats()
+{
+    for (u32 i = 0; i < governor_MAX; ++i)
+    {
+        governor_frames[i] = 0;
+    }
+}
+
+#endif  // SCAN_GOVERNOR_H
@@ -0,0 +1,244 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "bsp/board.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+#include "timer.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Keeps a few RAM tables across reboots in the last sector of the flash.
+ *  The sector is used as a log of fixed size records, a save writes the next free one
+ *  and the sector is only erased once it is full, which spreads the wear.
+ *  The newest record with a valid CRC wins, a record whose size doesn't match the registered
+ *  sections (e.g. after a firmware update changed them) is ignored and the tables keep their defaults.
+ *  Erasing and programming run with interrupts off and stall the core for up to ~50 ms,
+ *  so saves only happen when the caller says it is a good time (see storage_update()).
+ *
+ *  Wear is set by the record size: a sector holds FLASH_SECTOR_SIZE / storage_slot_size records,
+ *  e.g. 4 with one half's health tables (~1 KiB), so at most one erase per 40 minutes with STORAGE_INTERVAL.
+ *  At the flash's 100k erase cycles that is over 7 years of saving as often as allowed, around the clock.
+ */
+
+#define STORAGE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define STORAGE_MAGIC 0x4B49424FU  // "KIBO"
+#define STORAGE_INTERVAL 600000    // ms, at most one save per interval
+
+typedef struct storage_section_STRUCT
+{
+    void* data;
+    u32 size;
+} storage_section;
+
+typedef struct storage_header_STRUCT
+{
+    u32 magic;
+    u32 sequence;
+    u32 size;  // Of the payload, the sum of the sections' sizes
+    u32 crc;   // Of the payload
+} storage_header;
+
+static const storage_section* storage_sections = NULL;
+static u32 storage_section_count = 0;
+static u32 storage_size = 0;
+static u32 storage_slot_size = 0;
+static u32 storage_slot = 0;  // Of the newest record
+static u32 storage_sequence = 0;
+static u32 storage_saved_crc = 0;
+static u32 storage_saves = 0;
+static u32 storage_erases = 0;
+
+static u8 storage_buffer[FLASH_SECTOR_SIZE] __attribute__((aligned(4)));
+static struct cooldown_timer storage_cdt = {STORAGE_INTERVAL, 0};
+
+static u32 storage_crc32(u32 crc, const u8* data, u32 len)
+{
+    crc = ~crc;
+    for (u32 i = 0; i < len; ++i)
+    {
+        crc ^= data[i];
+        for (u32 bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static u32 storage_sections_crc()
+{
+    u32 crc = 0;
+    for (u32 i = 0; i < storage_section_count; ++i)
+    {
+        crc = storage_crc32(crc, storage_sections[i].data, storage_sections[i].size);
+    }
+    return crc;
+}
+
+static const u8* storage_slot_address(u32 slot) { return (const u8*)(uintptr_t)(XIP_BASE + STORAGE_OFFSET + slot * storage_slot_size); }
+
+// Restores the sections from the newest valid record, returns false if there is none
+bool storage_init(const storage_section* sections, u32 n)
+{
+    storage_sections = sections;
+    storage_section_count = n;
+
+    storage_size = 0;
+    for (u32 i = 0; i < n; ++i)
+    {
+        storage_size += sections[i].size;
+    }
+    storage_slot_size = (sizeof(storage_header) + storage_size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    if (storage_slot_size > FLASH_SECTOR_SIZE)
+    {
+        storage_section_count = 0;
+        return false;
+    }
+
+    const storage_header* newest = NULL;
+    for (u32 slot = 0; slot < FLASH_SECTOR_SIZE / storage_slot_size; ++slot)
+    {
+        const storage_header* header = (const storage_header*)storage_slot_address(slot);
+        if (header->magic != STORAGE_MAGIC || header->size != storage_size)
+        {
+            continue;
+        }
+        if (storage_crc32(0, (const u8*)(header + 1), header->size) != header->crc)
+        {
+            continue;
+        }
+        if (newest == NULL || (i32)(header->sequence - newest->sequence) > 0)
+        {
+            newest = header;
+            storage_slot = slot;
+        }
+    }
+
+    storage_cdt.last_update = board_millis();
+    if (newest == NULL)
+    {
+        storage_slot = FLASH_SECTOR_SIZE / storage_slot_size - 1;  // So the first save erases the sector
+        storage_saved_crc = storage_sections_crc();
+        return false;
+    }
+
+    storage_sequence = newest->sequence;
+    storage_saved_crc = newest->crc;
+
+    const u8* payload = (const u8*)(newest + 1);
+    for (u32 i = 0; i < n; ++i)
+    {
+        memcpy(sections[i].data, payload, sections[i].size);
+        payload += sections[i].size;
+    }
+    return true;
+}
+
+// Writes the sections to a new record, even if they didn't change
+void storage_save()
+{
+    if (storage_section_count == 0)
+    {
+        return;
+    }
+
+    memset(storage_buffer, 0xFF, storage_slot_size);
+    storage_header* header = (storage_header*)storage_buffer;
+    u8* payload = (u8*)(header + 1);
+    for (u32 i = 0; i < storage_section_count; ++i)
+    {
+        memcpy(payload, storage_sections[i].data, storage_sections[i].size);
+        payload += storage_sections[i].size;
+    }
+    header->magic = STORAGE_MAGIC;
+    header->sequence = ++storage_sequence;
+    header->size = storage_size;
+    header->crc = storage_crc32(0, (const u8*)(header + 1), storage_size);
+
+    // The next slot must still be erased, otherwise start over at the beginning of the sector
+    u32 slot = storage_slot + 1;
+    bool is_erase_needed = slot >= FLASH_SECTOR_SIZE / storage_slot_size;
+    if (!is_erase_needed)
+    {
+        const u8* address = storage_slot_address(slot);
+        for (u32 i = 0; i < storage_slot_size; ++i)
+        {
+            if (address[i] != 0xFF)
+            {
+                is_erase_needed = true;
+                break;
+            }
+        }
+    }
+    if (is_erase_needed)
+    {
+        slot = 0;
+    }
+
+    const u32 interrupts = save_and_disable_interrupts();
+    if (is_erase_needed)
+    {
+        flash_range_erase(STORAGE_OFFSET, FLASH_SECTOR_SIZE);
+        ++storage_erases;
+    }
+    flash_range_program(STORAGE_OFFSET + slot * storage_slot_size, storage_buffer, storage_slot_size);
+    restore_interrupts(interrupts);
+
+    storage_slot = slot;
+    storage_saved_crc = header->crc;
+    ++storage_saves;
+}
+
+// Saves once per STORAGE_INTERVAL if something changed, only when can_stall allows a long pause
+void storage_update(bool can_stall)
+{
+    if (!can_stall || storage_section_count == 0)
+    {
+        return;
+    }
+
+    if (storage_cdt.last_update + storage_cdt.cooldown > board_millis())
+    {
+        return;
+    }
+    storage_cdt.last_update = board_millis();
+
+    if (storage_sections_crc() != storage_saved_crc)
+    {
+        storage_save();
+    }
+}
+
+#endif  // STORAGE_H
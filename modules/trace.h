@@ -0,0 +1,260 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2025 Godefroy Juteau
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "events.h"
+#include "key_map.h"
+#include "pico/stdlib.h"
+#include "types.h"
+#include "usb_descriptors.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ *  Notes:
+ *  Every debounced event gets one entry, stamped as it travels through the firmware.
+ *  The ring always overwrites its oldest entry, so tracing never blocks the hot path.
+ *  Entries are read through the REPORT_ID_TRACE feature report (see trace_read_report()), in order and
+ *  only once nothing will stamp them anymore: sent to the host, superseded by a newer entry of the same key
+ *  before being put in a report, or older than TRACE_PENDING_US (a key with no keycode, any key on the
+ *  slave). Reading an entry earlier would lose the stages stamped after it.
+ */
+
+#define TRACE_SIZE 64U  // Must be a power of two
+#define TRACE_ENTRIES_PER_REPORT 3U  // Fits in TRACE_REPORT_SIZE after the 2 byte header
+#define TRACE_PENDING_US 250000U  // Far longer than a mounted host takes to read a report
+
+typedef enum trace_stages_ENUM
+{
+    trace_EDGE,      // First raw edge seen by the scan
+    trace_DEBOUNCE,  // Debounce decided on an event
+    trace_QUEUED,    // Put in a report
+    trace_COMPLETE,  // Report sent to the host
+    trace_MAX,
+} trace_stages;
+typedef struct trace_entry_STRUCT
+{
+    u8 key;      // Logical key position
+    u8 event;    // key_events
+    u8 stamped;  // Bit per trace_stages that was recorded
+    u8 report;   // Serial of the report the key went out in, 0 until queued
+    u32 time[trace_MAX];  // time_us_32() per stage
+} trace_entry;
+
+static trace_entry trace_ring[TRACE_SIZE];
+static u32 trace_head = 0;
+static u32 trace_tail = 0;
+static u32 trace_dropped = 0;
+
+static bool trace_raw[KEY_COUNT];
+static bool trace_edge_pending[KEY_COUNT];
+static u32 trace_edge_time[KEY_COUNT];
+
+static void __not_in_flash_func(trace_stamp)(trace_entry* entry, trace_stages stage, u32 time)
+{
+    entry->time[stage] = time;
+    entry->stamped |= 1U << stage;
+}
+
+static void __not_in_flash_func(trace_push)(u8 key, key_events event, u32 edge_time, u32 now)
+{
+    if (trace_head - trace_tail == TRACE_SIZE)
+    {
+        ++trace_tail;
+        ++trace_dropped;
+    }
+
+    trace_entry* entry = &trace_ring[trace_head & (TRACE_SIZE - 1)];
+    ++trace_head;
+
+    entry->key = key;
+    entry->event = event;
+    entry->stamped = 0;
+    entry->report = 0;
+    trace_stamp(entry, trace_EDGE, edge_time);
+    trace_stamp(entry, trace_DEBOUNCE, now);
+}
+
+// Called for every scanned key, remembers when its raw level first changed
+void __not_in_flash_func(trace_scan)(u32 i, bool is_pressed)
+{
+    if (is_pressed == trace_raw[i])
+    {
+        return;
+    }
+
+    trace_raw[i] = is_pressed;
+    if (!trace_edge_pending[i])
+    {
+        trace_edge_pending[i] = true;
+        trace_edge_time[i] = time_us_32();
+    }
+}
+
+// Called when debounce settles on a new event for a local key
+void __not_in_flash_func(trace_debounce)(u32 i, key_events event)
+{
+    const u32 now = time_us_32();
+    const u32 edge_time = trace_edge_pending[i] ? trace_edge_time[i] : now;
+    trace_edge_pending[i] = false;
+
+    if (event == event_RELEASED)
+    {
+        return;
+    }
+
+    trace_push(i, event, edge_time, now);
+}
+
+// Called when an event from the other half is received, it has no local edge
+void trace_remote(u32 i, key_events event)
+{
+    const u32 now = time_us_32();
+    trace_push(i, event, now, now);
+}
+
+// Called when a key is put in a report, matches its newest unqueued entry
+void __not_in_flash_func(trace_queued)(u32 key, u8 report)
+{
+    for (u32 n = trace_head; n != trace_tail; --n)
+    {
+        const u32 index = (n - 1) & (TRACE_SIZE - 1);
+        trace_entry* entry = &trace_ring[index];
+        if (entry->key != key)
+        {
+            continue;
+        }
+
+        if (!(entry->stamped & (1U << trace_QUEUED)))
+        {
+            trace_stamp(entry, trace_QUEUED, time_us_32());
+            entry->report = report;
+        }
+        return;
+    }
+}
+
+// Called when a report was sent to the host, stamps every key that went out in it
+void trace_complete(u8 report)
+{
+    const u32 now = time_us_32();
+    for (u32 n = trace_tail; n != trace_head; ++n)
+    {
+        trace_entry* entry = &trace_ring[n & (TRACE_SIZE - 1)];
+        if (entry->report == report && !(entry->stamped & (1U << trace_COMPLETE)))
+        {
+            trace_stamp(entry, trace_COMPLETE, now);
+        }
+    }
+}
+
+// Nothing will stamp the n-th entry anymore, trace_queued() only stamps the newest entry of a key
+static bool trace_is_done(u32 n, u32 now)
+{
+    const trace_entry* entry = &trace_ring[n & (TRACE_SIZE - 1)];
+    if ((entry->stamped & (1U << trace_COMPLETE)) || now - entry->time[trace_DEBOUNCE] >= TRACE_PENDING_US)
+    {
+        return true;
+    }
+
+    if (entry->stamped & (1U << trace_QUEUED))
+    {
+        return false;
+    }
+
+    for (u32 newer = n + 1; newer != trace_head; ++newer)
+    {
+        if (trace_ring[newer & (TRACE_SIZE - 1)].key == entry->key)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+u32 trace_count() { return trace_head - trace_tail; }
+
+// n-th unread entry, from the oldest
+const trace_entry* trace_get(u32 n) { return &trace_ring[(trace_tail + n) & (TRACE_SIZE - 1)]; }
+
+static void trace_write_u32(u8* buffer, u32 value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+    buffer[3] = value >> 24;
+}
+
+/*
+ *  Report layout (little endian):
+ *  [0] entry count, [1] entries dropped since last read (saturated)
+ *  then per entry: key, event, stamped, report, u32 time[trace_MAX]
+ *  Stages missing from "stamped" did not happen within TRACE_PENDING_US.
+ */
+u16 trace_read_report(u8* buffer, u16 reqlen)
+{
+    if (reqlen < TRACE_REPORT_SIZE)
+    {
+        return 0;
+    }
+
+    memset(buffer, 0, TRACE_REPORT_SIZE);
+
+    const u32 now = time_us_32();
+    u32 count = 0;
+    while (count < TRACE_ENTRIES_PER_REPORT && trace_tail != trace_head)
+    {
+        if (!trace_is_done(trace_tail, now))
+        {
+            break;
+        }
+
+        const trace_entry* entry = &trace_ring[trace_tail & (TRACE_SIZE - 1)];
+        u8* out = &buffer[2 + count * sizeof(trace_entry)];
+        out[0] = entry->key;
+        out[1] = entry->event;
+        out[2] = entry->stamped;
+        out[3] = entry->report;
+        for (u32 stage = 0; stage < trace_MAX; ++stage)
+        {
+            trace_write_u32(&out[4 + stage * 4], entry->time[stage]);
+        }
+
+        ++trace_tail;
+        ++count;
+    }
+
+    buffer[0] = count;
+    buffer[1] = trace_dropped > 0xFF ? 0xFF : trace_dropped;
+    trace_dropped = 0;
+
+    return TRACE_REPORT_SIZE;
+}
+
+#endif  // TRACE_H
@@ -39,7 +39,7 @@ typedef signed short i16;
 typedef unsigned int u32;
 typedef signed int i32;
 
-typedef unsigned long u64;
-typedef signed long i64;
+typedef unsigned long long u64;
+typedef signed long long i64;
 
 #endif  // TYPES_H
\ No newline at end of file
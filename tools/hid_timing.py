@@ -0,0 +1,474 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2025 Godefroy Juteau
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Measures the keyboard's USB report timing from the host, through Linux hidraw.
+
+record   reads the keyboard's input reports as they arrive, and the firmware's own timestamps from the
+         REPORT_ID_TRACE feature report (see modules/trace.h), then analyzes them
+analyze  analyzes a capture written by record
+replay   creates a virtual device with uhid, fed from a capture or a script, so record can be tried
+         with no keyboard attached
+
+Captures are JSON lines, {"t": us, "input": hex} or {"t": us, "trace": hex}, reports with their ID first.
+The host build writes them without a keyboard, "-" reads a capture from stdin:
+    build-host/simulate L1 L2 R7 | tools/hid_timing.py analyze -
+    build-host/simulate L1 L2 R7 | tools/hid_timing.py replay -
+(see host/simulate.c; its times are the host build's own, so they measure the firmware, not USB).
+
+A script lists the keys expected to go down, in order: TinyUSB's HID_KEY_* names without the prefix
+(or usage numbers), separated by whitespace, with + joining the keys of a combo (SHIFT_LEFT+A).
+Everything after a # is a comment.
+
+Report IDs and sizes are read from app/usb_descriptors.h, and key names from TinyUSB's class/hid/hid.h.
+"""
+
+import argparse
+import contextlib
+import difflib
+import fcntl
+import glob
+import json
+import os
+import re
+import select
+import statistics
+import struct
+import sys
+import time
+
+USB_VID = 0xCAFE  # USB_VID of app/usb_descriptors.c
+USB_PID = 0x4004  # USB_PID of app/usb_descriptors.c, without the console
+BUS_USB = 0x03
+POLL_INTERVAL_US = 1000  # HID_POLL_INTERVAL of app/usb_descriptors.c
+
+EVENTS = ("up", "down", "pressed", "released")  # Same order as key_events in modules/events.h
+TRACE_STAGES = ("edge", "debounce", "queued", "complete")  # Same order as trace_stages in modules/trace.h
+TRACE_ENTRY = struct.Struct("<4B4I")  # trace_entry: key, event, stamped, report, time[trace_MAX]
+TRACE_ENTRIES_PER_REPORT = 3
+KEYBOARD_KEYS = 6  # hid_keyboard_report_t: modifier, reserved, keycode[6]
+MODIFIER_FIRST = 0xE0  # Usage of bit 0 of the modifier byte, HID_KEY_CONTROL_LEFT
+
+# linux/uhid.h, every event is a u32 type followed by a packed union of at most UHID_DATA_MAX bytes
+UHID_DATA_MAX = 4096
+UHID_EVENT_SIZE = 4376
+UHID_DESTROY = 1
+UHID_GET_REPORT = 9
+UHID_GET_REPORT_REPLY = 10
+UHID_CREATE2 = 11
+UHID_INPUT2 = 12
+UHID_SET_REPORT = 13
+UHID_SET_REPORT_REPLY = 14
+EIO = 5
+
+
+class Reports:
+    """Report IDs and sizes shared with the firmware."""
+
+    def __init__(self, path):
+        with open(path, encoding="utf-8") as file:
+            text = file.read()
+
+        self.ids = {}
+        next_id = 0
+        for name, value in re.findall(r"(REPORT_ID_\w+)\s*(?:=\s*(\d+))?", re.search(r"enum\s*{([^}]*)}", text).group(1)):
+            next_id = int(value) if value else next_id
+            self.ids[name] = next_id
+            next_id += 1
+        defines = {name: int(value) for name, value in re.findall(r"#define\s+(\w+)\s+(\d+)\s*$", text, re.MULTILINE)}
+
+        self.keyboard = self.ids["REPORT_ID_KEYBOARD"]
+        self.nkro = self.ids["REPORT_ID_NKRO"]
+        self.trace = self.ids["REPORT_ID_TRACE"]
+        self.trace_size = defines["TRACE_REPORT_SIZE"]
+        self.nkro_keys = defines["NKRO_KEY_COUNT"]
+
+    def keys(self, report):
+        """Usages held in a keyboard or NKRO report, modifiers included, None for other reports."""
+        report_id, data = report[0], report[1:]
+        if report_id == self.keyboard:
+            held = {key for key in data[2 : 2 + KEYBOARD_KEYS] if key > 1}  # 1 is the rollover error
+        elif report_id == self.nkro:
+            bitmap = data[1 : 1 + self.nkro_keys // 8]
+            held = {i for i in range(len(bitmap) * 8) if bitmap[i // 8] & (1 << (i % 8))}
+        else:
+            return None
+        if data:
+            held |= {MODIFIER_FIRST + bit for bit in range(8) if data[0] & (1 << bit)}
+        return held
+
+    def keyboard_report(self, held):
+        """The keyboard report the firmware would send for these usages."""
+        modifiers = sum(1 << (key - MODIFIER_FIRST) for key in held if key >= MODIFIER_FIRST)
+        keys = sorted(key for key in held if key < MODIFIER_FIRST)[:KEYBOARD_KEYS]
+        return bytes([self.keyboard, modifiers, 0] + keys + [0] * (KEYBOARD_KEYS - len(keys)))
+
+    def trace_entries(self, report):
+        """Entries and dropped count of a trace feature report."""
+        data = report[1:]
+        count = min(data[0], TRACE_ENTRIES_PER_REPORT)
+        entries = []
+        for i in range(count):
+            key, event, stamped, serial, *times = TRACE_ENTRY.unpack_from(data, 2 + i * TRACE_ENTRY.size)
+            stages = {TRACE_STAGES[s]: times[s] for s in range(len(TRACE_STAGES)) if stamped & (1 << s)}
+            entries.append({"key": key, "event": EVENTS[event] if event < len(EVENTS) else event, "report": serial, "time": stages})
+        return entries, data[1]
+
+    def descriptor(self):
+        """Report descriptor of the replay device: the firmware's report layouts, in vendor collections so the
+        kernel doesn't type replayed keys into the session."""
+
+        def vendor(report_id, size, main_item):
+            return bytes(
+                [0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01, 0x85, report_id]
+                + [0x09, 0x02, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, size, main_item, 0x02, 0xC0]
+            )
+
+        return (
+            vendor(self.keyboard, 2 + KEYBOARD_KEYS, 0x81)
+            + vendor(self.trace, self.trace_size, 0xB1)
+            + vendor(self.nkro, 1 + self.nkro_keys // 8, 0x81)
+        )
+
+
+def read_hid_keys(path):
+    """TinyUSB's HID_KEY_* constants, prefix removed, by name."""
+    with open(path, encoding="utf-8") as file:
+        return {name: int(value, 0) for name, value in re.findall(r"#define\s+HID_KEY_(\w+)\s+(0x[0-9A-Fa-f]+|\d+)", file.read())}
+
+
+def read_script(path, hid_keys):
+    """Combos of a script, each one a sorted tuple of usages."""
+    combos = []
+    with open(path, encoding="utf-8") as file:
+        for line_number, line in enumerate(file, 1):
+            for token in line.split("#", 1)[0].split():
+                combo = []
+                for name in token.split("+"):
+                    if name in hid_keys:
+                        combo.append(hid_keys[name])
+                    elif re.fullmatch(r"0x[0-9A-Fa-f]+|\d+", name):
+                        combo.append(int(name, 0))
+                    else:
+                        raise SystemExit(f"{path}:{line_number}: error: unknown key {name}")
+                combos.append(tuple(sorted(combo)))
+    return combos
+
+
+def key_name(key, names):
+    return names.get(key, f"0x{key:02X}")
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def summary(values):
+    if not values:
+        return "none"
+    return (
+        f"{len(values)}, min {min(values)} median {int(statistics.median(values))} "
+        f"p99 {percentile(values, 0.99)} max {max(values)} us"
+    )
+
+
+def read_capture(path):
+    capture = []
+    with (open(path, encoding="utf-8") if path != "-" else contextlib.nullcontext(sys.stdin)) as file:
+        for line in file:
+            if line.strip():
+                record = json.loads(line)
+                kind = "input" if "input" in record else "trace"
+                capture.append((record["t"], kind, bytes.fromhex(record[kind])))
+    return capture
+
+
+def write_capture(path, capture):
+    with open(path, "w", encoding="utf-8") as file:
+        for t, kind, report in capture:
+            file.write(json.dumps({"t": t, kind: report.hex()}) + "\n")
+
+
+def analyze(capture, reports, names, expected):
+    """Prints what the host saw, returns 1 if the keys don't match the expected combos."""
+    held = {}  # Report ID -> usages held
+    down_time = {}
+    durations = []
+    gaps = []
+    downs = []  # Combos in the order they went down
+    last_time = None
+    key_reports = changes = unchanged = 0
+    entries = []
+    dropped = 0
+
+    for t, kind, report in capture:
+        if kind == "trace":
+            new_entries, new_dropped = reports.trace_entries(report)
+            entries += new_entries
+            dropped += new_dropped
+            continue
+
+        keys = reports.keys(report)
+        if keys is None:
+            continue
+        key_reports += 1
+        if last_time is not None:
+            gaps.append(t - last_time)
+        last_time = t
+
+        before = set().union(*held.values())
+        held[report[0]] = keys
+        after = set().union(*held.values())
+        pressed, released = sorted(after - before), sorted(before - after)
+        if not pressed and not released:
+            unchanged += 1
+        changes += len(pressed) + len(released)
+        if pressed:
+            downs.append(tuple(pressed))
+        for key in pressed:
+            down_time[key] = t
+        for key in released:
+            if key in down_time:
+                durations.append(t - down_time.pop(key))
+
+    print(f"reports: {key_reports}, {unchanged} without any change")
+    print(f"gaps between reports: {summary(gaps)}")
+    if gaps:
+        print(f"  {sum(gap < POLL_INTERVAL_US // 2 for gap in gaps)} under half the {POLL_INTERVAL_US} us poll interval")
+    print(f"press to release: {summary(durations)}")
+    if key_reports:
+        print(f"coalescing: {changes} key changes in {key_reports} reports, {changes / key_reports:.2f} per report")
+
+    if entries or dropped:
+        print(f"trace: {len(entries)} entries, {dropped} dropped by the firmware")
+        for first, last in (("edge", "debounce"), ("debounce", "queued"), ("queued", "complete"), ("edge", "complete")):
+            spans = [(e["time"][last] - e["time"][first]) & 0xFFFFFFFF for e in entries if first in e["time"] and last in e["time"]]
+            print(f"  {first} to {last}: {summary(spans)}")
+
+        # Entries are read in order and serials only wrap after 256 reports, so a run of one serial is one report
+        runs = []
+        previous = None
+        for entry in entries:
+            if "queued" not in entry["time"]:
+                continue
+            if entry["report"] == previous:
+                runs[-1] += 1
+            else:
+                runs.append(1)
+            previous = entry["report"]
+        if runs:
+            print(f"  {sum(runs)} events in {len(runs)} reports, {sum(runs) / len(runs):.2f} per report")
+
+    if expected is None:
+        return 0
+
+    status = 0
+    matcher = difflib.SequenceMatcher(None, expected, downs, autojunk=False)
+    for tag, i1, i2, j1, j2 in matcher.get_opcodes():
+        if tag in ("delete", "replace"):
+            for combo in expected[i1:i2]:
+                print(f"dropped: {'+'.join(key_name(key, names) for key in combo)} (expected #{expected.index(combo, i1) + 1})")
+                status = 1
+        if tag in ("insert", "replace"):
+            for j in range(j1, j2):
+                kind = "duplicated" if downs[j] in expected[max(0, i1 - 1) : i2 + 1] else "unexpected"
+                print(f"{kind}: {'+'.join(key_name(key, names) for key in downs[j])} (down #{j + 1})")
+                status = 1
+    print(f"expected {len(expected)} combos, got {len(downs)}, {'match' if status == 0 else 'mismatch'}")
+    return status
+
+
+def find_hidraw():
+    """The first hidraw node of a device with the firmware's vendor ID."""
+    for node in sorted(glob.glob("/sys/class/hidraw/hidraw*")):
+        try:
+            with open(os.path.join(node, "device", "uevent"), encoding="utf-8") as file:
+                match = re.search(r"HID_ID=\w+:(\w+):(\w+)", file.read())
+        except OSError:
+            continue
+        if match and int(match.group(1), 16) == USB_VID:
+            return "/dev/" + os.path.basename(node)
+    return None
+
+
+def hidiocgfeature(length):
+    return (3 << 30) | (length << 16) | (ord("H") << 8) | 0x07
+
+
+def now_us():
+    return time.monotonic_ns() // 1000
+
+
+def record(args, reports):
+    device = args.device or find_hidraw()
+    if device is None:
+        raise SystemExit(f"error: no hidraw device with vendor ID 0x{USB_VID:04X}, pass one with --device")
+
+    try:
+        fd = os.open(device, os.O_RDWR)
+    except OSError as error:
+        raise SystemExit(f"error: {device}: {error.strerror}")
+    capture = []
+    start = now_us()
+    next_trace = start
+    print(f"recording {device}, Ctrl+C to stop", file=sys.stderr)
+    try:
+        while args.seconds == 0 or now_us() - start < args.seconds * 1000000:
+            timeout = max(0, next_trace - now_us()) / 1000000 if args.trace_ms else 0.1
+            if select.select([fd], [], [], timeout)[0]:
+                report = os.read(fd, 64)
+                capture.append((now_us() - start, "input", report))
+
+            if args.trace_ms and now_us() >= next_trace:
+                # Drain the ring, each report only holds a few entries
+                while True:
+                    buffer = bytearray([reports.trace] + [0] * reports.trace_size)
+                    length = fcntl.ioctl(fd, hidiocgfeature(len(buffer)), buffer, True)
+                    if length <= 1 or buffer[1] == 0:
+                        break
+                    capture.append((now_us() - start, "trace", bytes(buffer[:length])))
+                    if buffer[1] < TRACE_ENTRIES_PER_REPORT:
+                        break
+                next_trace = now_us() + args.trace_ms * 1000
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(fd)
+
+    if args.output:
+        write_capture(args.output, capture)
+    return capture
+
+
+def uhid_event(kind, payload):
+    event = struct.pack("<I", kind) + payload
+    return event + bytes(UHID_EVENT_SIZE - len(event))
+
+
+def script_capture(combos, reports, tap_ms):
+    """Capture of the firmware tapping each combo, down in one report and up in the next one."""
+    capture = []
+    for i, combo in enumerate(combos):
+        t = i * tap_ms * 1000
+        capture.append((t, "input", reports.keyboard_report(combo)))
+        capture.append((t + tap_ms * 500, "input", reports.keyboard_report(())))
+    return capture
+
+
+def replay(args, reports, capture):
+    try:
+        fd = os.open("/dev/uhid", os.O_RDWR)
+    except OSError as error:
+        raise SystemExit(f"error: /dev/uhid: {error.strerror}, it needs the uhid module and usually root")
+    descriptor = reports.descriptor()
+    os.write(
+        fd,
+        uhid_event(
+            UHID_CREATE2,
+            struct.pack(
+                f"<128s64s64sHHIIII{UHID_DATA_MAX}s", b"kibo replay", b"", b"", len(descriptor), BUS_USB, USB_VID, USB_PID, 0, 0, descriptor
+            ),
+        ),
+    )
+    print(f"replaying {len(capture)} reports in {args.delay} s, record with --device /dev/hidrawN", file=sys.stderr)
+
+    traces = [(t, report) for t, kind, report in capture if kind == "trace"]
+    inputs = [(t, report) for t, kind, report in capture if kind == "input"]
+    empty_trace = bytes([reports.trace] + [0] * reports.trace_size)
+    start = now_us() + int(args.delay * 1000000)
+    end = start + (inputs[-1][0] if inputs else 0) + int(args.linger * 1000000)
+    sent = 0
+    try:
+        while now_us() < end:
+            # Trace reports are served in order to whoever asks, once they were read in the capture
+            due = inputs[sent][0] + start if sent < len(inputs) else end
+            if select.select([fd], [], [], max(0, due - now_us()) / 1000000)[0]:
+                event = os.read(fd, UHID_EVENT_SIZE)
+                kind = struct.unpack_from("<I", event)[0]
+                if kind == UHID_GET_REPORT:
+                    request, number = struct.unpack_from("<IB", event, 4)
+                    data = traces.pop(0)[1] if number == reports.trace and traces and now_us() >= traces[0][0] + start else empty_trace
+                    error = 0 if number == reports.trace else EIO
+                    data = data if error == 0 else b""
+                    os.write(fd, uhid_event(UHID_GET_REPORT_REPLY, struct.pack(f"<IHH{UHID_DATA_MAX}s", request, error, len(data), data)))
+                elif kind == UHID_SET_REPORT:
+                    request = struct.unpack_from("<I", event, 4)[0]
+                    os.write(fd, uhid_event(UHID_SET_REPORT_REPLY, struct.pack("<IH", request, EIO)))
+
+            while sent < len(inputs) and now_us() >= inputs[sent][0] + start:
+                report = inputs[sent][1]
+                os.write(fd, uhid_event(UHID_INPUT2, struct.pack(f"<H{UHID_DATA_MAX}s", len(report), report)))
+                sent += 1
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.write(fd, uhid_event(UHID_DESTROY, b""))
+        os.close(fd)
+    return 0
+
+
+def main():
+    tools = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--descriptors", default=os.path.join(tools, "..", "app", "usb_descriptors.h"), help="app/usb_descriptors.h")
+    parser.add_argument("--hid-header", help="TinyUSB's class/hid/hid.h, for key names")
+    parser.add_argument("--expect", help="script of the keys expected to go down, to find dropped and duplicated ones")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    record_parser = commands.add_parser("record", help="record and analyze a keyboard")
+    record_parser.add_argument("--device", help="hidraw node, the first one with the firmware's vendor ID by default")
+    record_parser.add_argument("--seconds", type=float, default=0, help="stop after this long (0: on Ctrl+C)")
+    record_parser.add_argument("--trace-ms", type=int, default=50, help="how often to read the firmware's trace (0: never)")
+    record_parser.add_argument("-o", "--output", help="also write the capture to this file")
+
+    analyze_parser = commands.add_parser("analyze", help="analyze a capture")
+    analyze_parser.add_argument("capture", help="capture written by record or host/simulate, - for stdin")
+
+    replay_parser = commands.add_parser("replay", help="play a capture or a script through a uhid device")
+    replay_parser.add_argument("input", help="capture, - for stdin, or script with --script")
+    replay_parser.add_argument("--script", action="store_true", help="input is a script, each combo is tapped")
+    replay_parser.add_argument("--tap-ms", type=int, default=20, help="time between two taps of a script")
+    replay_parser.add_argument("--delay", type=float, default=2, help="seconds to wait before replaying, to start record")
+    replay_parser.add_argument("--linger", type=float, default=1, help="seconds to keep the device after the last report")
+    args = parser.parse_args()
+
+    reports = Reports(args.descriptors)
+    hid_keys = read_hid_keys(args.hid_header) if args.hid_header else {}
+    names = {value: name for name, value in hid_keys.items()}
+    expected = read_script(args.expect, hid_keys) if args.expect else None
+
+    if args.command == "replay":
+        if args.script:
+            capture = script_capture(read_script(args.input, hid_keys), reports, args.tap_ms)
+        else:
+            capture = read_capture(args.input)
+        return replay(args, reports, capture)
+
+    capture = record(args, reports) if args.command == "record" else read_capture(args.capture)
+    return analyze(capture, reports, names, expected)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,455 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2025 Godefroy Juteau
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Compiles a layout file (see layouts/kibo40.layout) into the key map tables of the firmware.
+
+Every distinct combo is stored once, and each key/event of each layer only holds the index of its combo.
+Any conflict or mistake in the layout is reported with its line, and fails the build.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SIDES = ("left", "right")
+SIDE_PREFIXES = ("L", "R")
+EVENTS = ("up", "down", "pressed")  # Same order as key_events in modules/events.h
+KEYS_PER_COMBO = 6
+REPEAT_MODES = ("normal", "fast")  # Same order as repeat_modes in modules/key_map.h, after repeat_NONE
+DIODES = ("col2row", "row2col")
+MAX_HALF_KEYS = (16 - 1) * 8  # A keyframe has to fit in a reliable link frame, see modules/key_state.h
+GP_NONE = 0xFF  # Pin map padding of the half with fewer keys, see modules/key_map.h
+
+# Pins the firmware already uses for something else
+RESERVED_PINS = {
+    0: "link TX (modules/link_uart.h)",
+    1: "link RX (modules/link_uart.h, modules/link_pio.h)",
+    24: "VBUS sense (modules/role.h)",
+    25: "debug LED (modules/debug_led.h)",
+    28: "handedness strap (modules/role.h)",
+}
+
+
+class Layout:
+    def __init__(self):
+        self.pins = {}
+        self.matrices = {}  # side -> (row pins, column pins)
+        self.diodes = None
+        self.layers = []  # layer -> {(side, index): {event: [keycodes]}}
+        self.repeats = []  # layer -> {(side, index): mode}
+        self.gaming = []  # layer -> bool
+        self.socd = []  # (layer, key, key, line)
+        self.errors = []
+        self.gotos = []  # (line, target layer), checked once every layer is known
+        self.keys = []  # (line, token, key), checked once both halves are known
+
+    def error(self, line_number, message):
+        self.errors.append((line_number, message))
+
+    def half_keys(self, side):
+        """Key count of a half, None until its pins are known."""
+        if side in self.pins:
+            return len(self.pins[side])
+        if side in self.matrices:
+            rows, cols = self.matrices[side]
+            return len(rows) * len(cols)
+        return None
+
+    def matrix_size(self):
+        """Rows and columns of the generated matrix, the biggest of both halves."""
+        return max(len(self.matrices[side][0]) for side in self.matrices), max(len(self.matrices[side][1]) for side in self.matrices)
+
+    def gp_count(self):
+        """Keys per half in the firmware, the halves are padded to the one with the most keys."""
+        if self.matrices:
+            rows, cols = self.matrix_size()
+            return rows * cols
+        return max(len(pins) for pins in self.pins.values())
+
+    def has_key(self, side, index):
+        if side in self.pins:
+            return index < len(self.pins[side])
+        rows, cols = self.matrices[side]
+        return index // self.matrix_size()[1] < len(rows) and index % self.matrix_size()[1] < len(cols)
+
+
+def read_hid_keys(path):
+    """Names of TinyUSB's HID_KEY_* constants, prefix removed."""
+    with open(path, encoding="utf-8") as file:
+        return set(re.findall(r"#define\s+HID_KEY_(\w+)", file.read()))
+
+
+def parse_key(layout, line_number, token):
+    match = re.fullmatch(r"([LR])(\d+)", token)
+    if not match:
+        return None
+    key = SIDE_PREFIXES.index(match.group(1)), int(match.group(2))
+    layout.keys.append((line_number, token, key))
+    return key
+
+
+def check_pins(layout, line_number, pins):
+    for pin in pins:
+        if pin in RESERVED_PINS:
+            layout.error(line_number, f"GP{pin} is reserved for the {RESERVED_PINS[pin]}")
+        if pins.count(pin) > 1:
+            layout.error(line_number, f"GP{pin} is used more than once")
+            break
+
+
+def parse_combo(layout, line_number, tokens, hid_keys):
+    if tokens and tokens[0] == "GOTO_LAYER":
+        if len(tokens) != 2 or not tokens[1].isdigit():
+            layout.error(line_number, "GOTO_LAYER takes exactly one layer number")
+            return None
+        return ["GOTO_LAYER", int(tokens[1])]
+
+    if not tokens:
+        layout.error(line_number, "empty combo")
+        return None
+    if len(tokens) > KEYS_PER_COMBO:
+        layout.error(line_number, f"combo of {len(tokens)} keycodes, at most {KEYS_PER_COMBO} are sent at once")
+        return None
+    for token in tokens:
+        if hid_keys is not None and token not in hid_keys:
+            layout.error(line_number, f"unknown keycode {token}")
+            return None
+    return tokens
+
+
+def parse(path, hid_keys):
+    layout = Layout()
+    with open(path, encoding="utf-8") as file:
+        lines = file.readlines()
+
+    for line_number, line in enumerate(lines, 1):
+        line = line.split("#", 1)[0].strip()
+        if not line:
+            continue
+        tokens = line.split()
+
+        if tokens[0] == "pins":
+            if len(tokens) < 3 or tokens[1] not in SIDES:
+                layout.error(line_number, "expected: pins <left|right> <gpio...>")
+                continue
+            side = SIDES.index(tokens[1])
+            if layout.half_keys(side) is not None:
+                layout.error(line_number, f"pins of the {tokens[1]} half are already defined")
+                continue
+            if not all(token.isdigit() for token in tokens[2:]):
+                layout.error(line_number, "pins must be GPIO numbers")
+                continue
+            pins = [int(token) for token in tokens[2:]]
+            check_pins(layout, line_number, pins)
+            layout.pins[side] = pins
+            continue
+
+        if tokens[0] == "matrix":
+            if len(tokens) < 6 or tokens[1] not in SIDES or tokens[2] != "rows" or "cols" not in tokens[4:]:
+                layout.error(line_number, "expected: matrix <left|right> rows <gpio...> cols <gpio...>")
+                continue
+            side = SIDES.index(tokens[1])
+            if layout.half_keys(side) is not None:
+                layout.error(line_number, f"pins of the {tokens[1]} half are already defined")
+                continue
+            split = tokens.index("cols")
+            if split == len(tokens) - 1 or not all(token.isdigit() for token in tokens[3:split] + tokens[split + 1 :]):
+                layout.error(line_number, "rows and cols must be GPIO numbers")
+                continue
+            rows = [int(token) for token in tokens[3:split]]
+            cols = [int(token) for token in tokens[split + 1 :]]
+            check_pins(layout, line_number, rows + cols)
+            layout.matrices[side] = (rows, cols)
+            continue
+
+        if tokens[0] == "diodes":
+            if len(tokens) != 2 or tokens[1] not in DIODES:
+                layout.error(line_number, "expected: diodes <col2row|row2col>")
+            elif layout.diodes is not None:
+                layout.error(line_number, "diodes are already defined")
+            else:
+                layout.diodes = (tokens[1], line_number)
+            continue
+
+        if tokens[0] == "layer":
+            is_valid = len(tokens) in (2, 3) and tokens[1].isdigit() and int(tokens[1]) == len(layout.layers)
+            if not is_valid or (len(tokens) == 3 and tokens[2] != "gaming"):
+                layout.error(line_number, f"expected: layer {len(layout.layers)} [gaming]")
+            layout.layers.append({})
+            layout.repeats.append({})
+            layout.gaming.append(len(tokens) == 3 and tokens[2] == "gaming")
+            continue
+
+        if tokens[0] == "socd":
+            keys = [parse_key(layout, line_number, token) for token in tokens[1:]]
+            if len(keys) != 2 or None in keys or keys[0] == keys[1]:
+                layout.error(line_number, "expected: socd <key> <key>")
+            elif not layout.layers or not layout.gaming[-1]:
+                layout.error(line_number, "socd pairs only make sense on a gaming layer")
+            else:
+                layout.socd.append((len(layout.layers) - 1, keys[0], keys[1], line_number))
+            continue
+
+        key = parse_key(layout, line_number, tokens[0])
+        if key is None:
+            layout.error(line_number, f"unknown key {tokens[0]}")
+            continue
+        if not layout.layers:
+            layout.error(line_number, "key defined before any layer")
+            continue
+
+        layer = layout.layers[-1]
+        if key in layer:
+            layout.error(line_number, f"{tokens[0]} is already defined on layer {len(layout.layers) - 1}")
+            continue
+        actions = layer[key] = {}
+
+        # Split "<event>: <keycodes...>" groups
+        event = None
+        skip = False
+        combo = []
+        for token in tokens[1:] + [None]:
+            if token is None or token.endswith(":"):
+                if event == "repeat":
+                    if len(combo) != 1 or combo[0] not in REPEAT_MODES:
+                        layout.error(line_number, f"expected: repeat: <{'|'.join(REPEAT_MODES)}>")
+                    else:
+                        layout.repeats[-1][key] = combo[0]
+                elif event is not None:
+                    result = parse_combo(layout, line_number, combo, hid_keys)
+                    if result is not None:
+                        actions[event] = result
+                        if result[0] == "GOTO_LAYER":
+                            layout.gotos.append((line_number, result[1]))
+                if token is None:
+                    break
+                event = token[:-1]
+                skip = False
+                combo = []
+                if event == "repeat" and key in layout.repeats[-1]:
+                    layout.error(line_number, f"{tokens[0]} already has a repeat mode")
+                    event = None
+                    skip = True
+                elif event != "repeat" and event not in EVENTS:
+                    layout.error(line_number, f"unknown event {event}, expected one of {', '.join(EVENTS)}")
+                    event = None
+                    skip = True
+                elif event in actions:
+                    layout.error(line_number, f"{tokens[0]} already has a {event} combo, the second one would override it")
+                    event = None
+                    skip = True
+                continue
+            if skip:
+                continue
+            if event is None:
+                layout.error(line_number, f"keycode {token} outside of an event")
+                break
+            combo.append(token)
+
+        if key in layout.repeats[-1]:
+            down = actions.get("down")
+            if down is None or down[0] == "GOTO_LAYER":
+                layout.error(line_number, f"{tokens[0]} repeats but has no down combo to repeat")
+            elif "pressed" in actions:
+                layout.error(line_number, f"{tokens[0]} can't both repeat and have a pressed combo, the hold would do both")
+
+    if len(layout.pins) + len(layout.matrices) != len(SIDES):
+        layout.error(len(lines), "pins of both halves must be defined")
+    elif layout.pins and layout.matrices:
+        layout.error(len(lines), "both halves must be wired the same way, one pin per key or a matrix")
+    elif layout.gp_count() > MAX_HALF_KEYS:
+        layout.error(len(lines), f"{layout.gp_count()} keys per half, at most {MAX_HALF_KEYS} fit in the key state sent between halves")
+    else:
+        for line_number, token, (side, index) in layout.keys:
+            if not layout.has_key(side, index):
+                layout.error(line_number, f"unknown key {token}, the {SIDES[side]} half has no such key")
+    if layout.diodes is not None and not layout.matrices:
+        layout.error(layout.diodes[1], "diodes only apply to a matrix")
+    if not layout.layers:
+        layout.error(len(lines), "no layer defined")
+
+    for layer, first, second, line_number in layout.socd:
+        for key in (first, second):
+            down = layout.layers[layer].get(key, {}).get("down")
+            if down is None or down[0] == "GOTO_LAYER":
+                layout.error(line_number, f"{SIDE_PREFIXES[key[0]]}{key[1]} has no down combo to resolve")
+
+    for layer, repeats in enumerate(layout.repeats):
+        if layout.gaming[layer] and repeats:
+            layout.error(len(lines), f"layer {layer} is a gaming layer, its keys are held so the host repeats them")
+
+    for line_number, target in layout.gotos:
+        if target >= len(layout.layers):
+            layout.error(line_number, f"GOTO_LAYER {target}, but there are only {len(layout.layers)} layers")
+
+    return layout
+
+
+def combo_to_c(combo):
+    if combo[0] == "GOTO_LAYER":
+        return f"{{HID_KEY_GOTO_LAYER, {combo[1]}}}"
+    return "{" + ", ".join(f"HID_KEY_{keycode}" for keycode in combo) + "}"
+
+
+def pin_to_c(pin):
+    return "GP_NONE" if pin == GP_NONE else str(pin)
+
+
+def generate(layout, source):
+    gp_count = layout.gp_count()
+
+    combos = [None]  # Combo 0 is the empty one
+    combo_indices = {}
+    actions = []
+    for layer in layout.layers:
+        layer_actions = []
+        for side in range(len(SIDES)):
+            for index in range(gp_count):
+                key_actions = []
+                for event in EVENTS:
+                    combo = layer.get((side, index), {}).get(event)
+                    if combo is None:
+                        key_actions.append(0)
+                        continue
+                    text = combo_to_c(combo)
+                    if text not in combo_indices:
+                        combo_indices[text] = len(combos)
+                        combos.append(text)
+                    key_actions.append(combo_indices[text])
+                layer_actions.append(key_actions)
+        actions.append(layer_actions)
+
+    if len(combos) > 256:
+        raise SystemExit(f"{source}: error: {len(combos)} distinct combos, at most 256 fit in the packed table")
+
+    out = []
+    out.append(f"// Generated by tools/keymap.py from {os.path.basename(source)}, do not edit")
+    out.append("")
+    out.append("#ifndef KEY_MAP_LAYOUT_H")
+    out.append("#define KEY_MAP_LAYOUT_H")
+    out.append("")
+    out.append(f"#define GP_COUNT {gp_count}U")
+    out.append(f"#define LAYER_COUNT {len(layout.layers)}U")
+    out.append(f"#define COMBO_COUNT {len(combos)}U")
+    out.append("")
+    if layout.matrices:
+        row_count, col_count = layout.matrix_size()
+        diodes = layout.diodes[0] if layout.diodes is not None else DIODES[0]
+        out.append("// Keys are scanned as a matrix, key i is at row i / MATRIX_COLS and column i % MATRIX_COLS (see key_scan.h)")
+        out.append("#define KEY_MATRIX")
+        out.append(f"#define MATRIX_ROWS {row_count}U")
+        out.append(f"#define MATRIX_COLS {col_count}U")
+        out.append(f"#define MATRIX_COL2ROW {int(diodes == 'col2row')}")
+        for side, name in enumerate(SIDES):
+            rows, cols = layout.matrices[side]
+            rows = rows + [GP_NONE] * (row_count - len(rows))
+            cols = cols + [GP_NONE] * (col_count - len(cols))
+            out.append(f"static const u32 matrix_rows_{name}[MATRIX_ROWS] = {{{', '.join(pin_to_c(pin) for pin in rows)}}};")
+            out.append(f"static const u32 matrix_cols_{name}[MATRIX_COLS] = {{{', '.join(pin_to_c(pin) for pin in cols)}}};")
+    else:
+        for side, name in enumerate(SIDES):
+            pins = layout.pins[side] + [GP_NONE] * (gp_count - len(layout.pins[side]))
+            out.append(f"static const u32 gp_map_{name}[GP_COUNT] = {{{', '.join(pin_to_c(pin) for pin in pins)}}};")
+    out.append("")
+    out.append("// Every distinct combo once, combo 0 sends nothing, kept in SRAM (see key_map.h)")
+    out.append('static const u8 __not_in_flash("keymap") key_combos[COMBO_COUNT][KEYS_PER_COMBO] = {')
+    out.append("    {0},")
+    for combo in combos[1:]:
+        out.append(f"    {combo},")
+    out.append("};")
+    out.append("")
+    out.append("// Combo of every logical key position and event (up, down, pressed)")
+    out.append("static const u8 key_actions[LAYER_COUNT][KEY_COUNT][event_MAX - 1] = {")
+    for number, layer_actions in enumerate(actions):
+        out.append(f"    // Layer {number}")
+        out.append("    {")
+        for position, key_actions in enumerate(layer_actions):
+            name = f"{SIDE_PREFIXES[position // gp_count]}{position % gp_count}"
+            out.append(f"        {{{', '.join(str(index) for index in key_actions)}}},  // {name}")
+        out.append("    },")
+    out.append("};")
+    out.append("")
+    out.append("// Keys that auto-repeat their down combo, the others are repeat_NONE")
+    out.append("static const u8 key_repeats[LAYER_COUNT][KEY_COUNT] = {")
+    if not any(layout.repeats):
+        out.append("    {0},")
+    for number, repeats in enumerate(layout.repeats):
+        if not repeats:
+            continue
+        out.append(f"    [{number}] = {{")
+        for (side, index), mode in sorted(repeats.items()):
+            out.append(f"        [{side * gp_count + index}] = repeat_{mode.upper()},  // {SIDE_PREFIXES[side]}{index}")
+        out.append("    },")
+    out.append("};")
+    out.append("")
+    out.append("// Layers where keys are reported as held, see gaming.h")
+    gaming = [str(layer) for layer, is_gaming in enumerate(layout.gaming) if is_gaming]
+    out.append("static const u8 layer_gaming[LAYER_COUNT] = {" + ", ".join(f"[{layer}] = 1" for layer in gaming) + ("" if gaming else "0") + "};")
+    out.append("")
+    out.append("// Opposing directions resolved by SOCD: layer, key, key")
+    out.append(f"#define SOCD_COUNT {len(layout.socd)}U")
+    out.append("static const u8 socd_pairs[SOCD_COUNT + 1][3] = {")
+    for layer, first, second, _ in layout.socd:
+        out.append(f"    {{{layer}, {first[0] * gp_count + first[1]}, {second[0] * gp_count + second[1]}}},")
+    out.append("    {0},  // Keeps the table valid when there are none")
+    out.append("};")
+    out.append("")
+    out.append("#endif  // KEY_MAP_LAYOUT_H")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("layout", help="layout file to compile")
+    parser.add_argument("-o", "--output", required=True, help="generated header")
+    parser.add_argument("--hid-header", help="TinyUSB's class/hid/hid.h, to check keycode names")
+    args = parser.parse_args()
+
+    hid_keys = None
+    if args.hid_header:
+        try:
+            hid_keys = read_hid_keys(args.hid_header)
+        except OSError as error:
+            print(f"{args.hid_header}: error: {error.strerror}, keycodes can't be checked", file=sys.stderr)
+            return 1
+
+    layout = parse(args.layout, hid_keys)
+    if layout.errors:
+        for line_number, message in layout.errors:
+            print(f"{args.layout}:{line_number}: error: {message}", file=sys.stderr)
+        return 1
+
+    header = generate(layout, args.layout)
+
+    # Always written, even unchanged, so the build sees it as newer than what it was generated from
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, "w", encoding="utf-8") as file:
+        file.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2025 Godefroy Juteau
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Reports how much flash and SRAM each module of the firmware takes, from the symbols of its ELF.
+
+Modules are the files symbols are defined in (modules/*.h, app/*.c), the SDK and TinyUSB are summed as one each.
+Only symbols are counted, so stacks, heap and padding are not part of the totals.
+Functions and tables placed in SRAM (__not_in_flash_func) also take flash, for the image they are copied from.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+FLASH_START = 0x10000000
+RAM_START = 0x20000000
+LOADED_TYPES = set("tTdDrR")  # Symbols in SRAM with an image in flash, the others are zeroed at boot
+
+
+def module_of(path):
+    if not path:
+        return "(unknown)"
+    path = path.replace("\\", "/")
+    if "/tinyusb/" in path:
+        return "tinyusb"
+    if "/pico-sdk/" in path or "/pico_" in path or "/hardware_" in path:
+        return "pico-sdk"
+    return os.path.basename(path)
+
+
+def read_symbols(nm, elf):
+    output = subprocess.run(
+        [nm, "--print-size", "--line-numbers", "--defined-only", elf], check=True, capture_output=True, text=True
+    ).stdout
+
+    for line in output.splitlines():
+        fields, _, location = line.partition("\t")
+        fields = fields.split()
+        if len(fields) != 4:
+            continue  # No size
+        address, size, kind, name = int(fields[0], 16), int(fields[1], 16), fields[2], fields[3]
+        yield address, size, kind, name, location.rsplit(":", 1)[0]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("elf", help="firmware to measure")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm of the toolchain")
+    parser.add_argument("-o", "--output", help="also write the report to this file")
+    parser.add_argument("--flash-budget", type=int, default=0, help="fail if more flash is used, in bytes (0: no limit)")
+    parser.add_argument("--ram-budget", type=int, default=0, help="fail if more SRAM is used, in bytes (0: no limit)")
+    args = parser.parse_args()
+
+    modules = {}  # module -> [flash, ram, ram code]
+    for address, size, kind, _, location in read_symbols(args.nm, args.elf):
+        usage = modules.setdefault(module_of(location), [0, 0, 0])
+        if FLASH_START <= address < RAM_START:
+            usage[0] += size
+        elif address >= RAM_START:
+            usage[1] += size
+            if kind in LOADED_TYPES:
+                usage[0] += size
+            if kind in "tT":
+                usage[2] += size
+
+    lines = [f"{'module':<24} {'flash':>8} {'sram':>8} {'sram code':>10}"]
+    for module, (flash, ram, ram_code) in sorted(modules.items(), key=lambda item: -(item[1][0] + item[1][1])):
+        lines.append(f"{module:<24} {flash:>8} {ram:>8} {ram_code:>10}")
+    total_flash = sum(usage[0] for usage in modules.values())
+    total_ram = sum(usage[1] for usage in modules.values())
+    total_ram_code = sum(usage[2] for usage in modules.values())
+    lines.append(f"{'total':<24} {total_flash:>8} {total_ram:>8} {total_ram_code:>10}")
+    report = "\n".join(lines) + "\n"
+
+    print(report, end="")
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as file:
+            file.write(report)
+
+    status = 0
+    if args.flash_budget and total_flash > args.flash_budget:
+        print(f"{args.elf}: error: {total_flash} bytes of flash used, the budget is {args.flash_budget}", file=sys.stderr)
+        status = 1
+    if args.ram_budget and total_ram > args.ram_budget:
+        print(f"{args.elf}: error: {total_ram} bytes of SRAM used, the budget is {args.ram_budget}", file=sys.stderr)
+        status = 1
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())